@@ -0,0 +1,430 @@
+#include "utils/threads.h"
+
+#include "blockcompress.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define MYGL_BC_SSE
+#endif
+
+namespace mygl {
+
+namespace bc {
+
+namespace {
+
+struct Block {
+  float px[16][4];  // rgba, 0..255
+};
+
+// palette stored channel-major so four entries can be tested at once
+struct Palette {
+  alignas(16) float c[4][16];
+  int count;
+};
+
+const int bc7Weights[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+void loadBlock(MyGL_ROImage image, uint32_t bx, uint32_t by, Block &block) {
+  for (uint32_t y = 0; y < 4; y++) {
+    const MyGL_Color *row = &image.pixels[(size_t) std::min(by * 4 + y, image.h - 1) * image.w];
+    for (uint32_t x = 0; x < 4; x++) {
+      const MyGL_Color &c = row[std::min(bx * 4 + x, image.w - 1)];
+      float *p = block.px[y * 4 + x];
+      // memory order is BGRA
+      p[0] = c.rgba[2];
+      p[1] = c.rgba[1];
+      p[2] = c.rgba[0];
+      p[3] = c.rgba[3];
+    }
+  }
+}
+
+// index of the palette entry closest to p, squared error in err
+int nearest(const Palette &pal, const float *p, int channels, float &err) {
+  int best = 0;
+  float bestErr = 1e30f;
+#ifdef MYGL_BC_SSE
+  for (int k = 0; k < pal.count; k += 4) {
+    __m128 d = _mm_setzero_ps();
+    for (int c = 0; c < channels; c++) {
+      __m128 t = _mm_sub_ps(_mm_load_ps(&pal.c[c][k]), _mm_set1_ps(p[c]));
+      d = _mm_add_ps(d, _mm_mul_ps(t, t));
+    }
+    alignas(16) float e[4];
+    _mm_store_ps(e, d);
+    for (int i = 0; i < 4; i++) {
+      if (e[i] < bestErr) {
+        bestErr = e[i];
+        best = k + i;
+      }
+    }
+  }
+#else
+  for (int k = 0; k < pal.count; k++) {
+    float e = 0.0f;
+    for (int c = 0; c < channels; c++) {
+      float t = pal.c[c][k] - p[c];
+      e += t * t;
+    }
+    if (e < bestErr) {
+      bestErr = e;
+      best = k;
+    }
+  }
+#endif
+  err = bestErr;
+  return best;
+}
+
+// endpoints at the extremes of the block along its principal axis
+void principalEndpoints(const Block &block, int channels, float e0[4], float e1[4]) {
+  float mean[4] = { }, cov[4][4] = { };
+  for (int i = 0; i < 16; i++)
+    for (int c = 0; c < channels; c++)
+      mean[c] += block.px[i][c] * (1.0f / 16.0f);
+  for (int i = 0; i < 16; i++)
+    for (int a = 0; a < channels; a++)
+      for (int b = a; b < channels; b++)
+        cov[a][b] += (block.px[i][a] - mean[a]) * (block.px[i][b] - mean[b]);
+  for (int a = 0; a < channels; a++)
+    for (int b = 0; b < a; b++)
+      cov[a][b] = cov[b][a];
+
+  // power iteration
+  float axis[4] = { 1.0f, 1.0f, 1.0f, 1.0f };
+  for (int it = 0; it < 8; it++) {
+    float next[4] = { }, len = 0.0f;
+    for (int a = 0; a < channels; a++) {
+      for (int b = 0; b < channels; b++)
+        next[a] += cov[a][b] * axis[b];
+      len = std::max(len, fabsf(next[a]));
+    }
+    if (len < 1e-6f)
+      break;
+    for (int a = 0; a < channels; a++)
+      axis[a] = next[a] / len;
+  }
+
+  float lo = 1e30f, hi = -1e30f, norm = 0.0f;
+  for (int c = 0; c < channels; c++)
+    norm += axis[c] * axis[c];
+  for (int i = 0; i < 16; i++) {
+    float t = 0.0f;
+    for (int c = 0; c < channels; c++)
+      t += (block.px[i][c] - mean[c]) * axis[c];
+    lo = std::min(lo, t);
+    hi = std::max(hi, t);
+  }
+  if (norm > 0.0f) {
+    lo /= norm;
+    hi /= norm;
+  }
+  for (int c = 0; c < channels; c++) {
+    e0[c] = std::clamp(mean[c] + lo * axis[c], 0.0f, 255.0f);
+    e1[c] = std::clamp(mean[c] + hi * axis[c], 0.0f, 255.0f);
+  }
+}
+
+// least squares endpoints for fixed per-pixel weights (color = e0 + w * (e1 - e0)), false if degenerate
+bool refineEndpoints(const Block &block, const float w[16], int channels, float e0[4], float e1[4]) {
+  float a = 0.0f, b = 0.0f, c = 0.0f, x[4] = { }, y[4] = { };
+  for (int i = 0; i < 16; i++) {
+    float u = 1.0f - w[i];
+    a += u * u;
+    b += u * w[i];
+    c += w[i] * w[i];
+    for (int ch = 0; ch < channels; ch++) {
+      x[ch] += u * block.px[i][ch];
+      y[ch] += w[i] * block.px[i][ch];
+    }
+  }
+  float det = a * c - b * b;
+  if (fabsf(det) < 1e-6f)
+    return false;
+  for (int ch = 0; ch < channels; ch++) {
+    e0[ch] = std::clamp((c * x[ch] - b * y[ch]) / det, 0.0f, 255.0f);
+    e1[ch] = std::clamp((a * y[ch] - b * x[ch]) / det, 0.0f, 255.0f);
+  }
+  return true;
+}
+
+// -- BC1 color block (also the color half of BC3) --
+
+uint16_t to565(const float *c) {
+  int r = (int) (c[0] * 31.0f / 255.0f + 0.5f);
+  int g = (int) (c[1] * 63.0f / 255.0f + 0.5f);
+  int b = (int) (c[2] * 31.0f / 255.0f + 0.5f);
+  return (uint16_t) ((r << 11) | (g << 5) | b);
+}
+
+void from565(uint16_t v, float *c) {
+  int r = (v >> 11) & 31, g = (v >> 5) & 63, b = v & 31;
+  c[0] = (float) ((r << 3) | (r >> 2));
+  c[1] = (float) ((g << 2) | (g >> 4));
+  c[2] = (float) ((b << 3) | (b >> 2));
+}
+
+// palette order 0 = c0, 1 = c1, 2 = 2/3 c0 + 1/3 c1, 3 = 1/3 c0 + 2/3 c1
+const float bc1Weights[4] = { 0.0f, 1.0f, 1.0f / 3.0f, 2.0f / 3.0f };
+
+float bc1Indices(const Block &block, uint16_t c0, uint16_t c1, uint8_t idx[16]) {
+  float a[3], b[3];
+  from565(c0, a);
+  from565(c1, b);
+  Palette pal;
+  pal.count = 4;
+  for (int c = 0; c < 3; c++) {
+    pal.c[c][0] = a[c];
+    pal.c[c][1] = b[c];
+    pal.c[c][2] = (float) (int) ((2.0f * a[c] + b[c]) / 3.0f);
+    pal.c[c][3] = (float) (int) ((a[c] + 2.0f * b[c]) / 3.0f);
+  }
+  float total = 0.0f;
+  for (int i = 0; i < 16; i++) {
+    float err;
+    idx[i] = (uint8_t) nearest(pal, block.px[i], 3, err);
+    total += err;
+  }
+  return total;
+}
+
+void writeBC1(uint16_t c0, uint16_t c1, const uint8_t idx[16], uint8_t *out) {
+  // four color mode needs c0 > c1, swapping the endpoints swaps indices 0/1 and 2/3
+  uint8_t flip = 0;
+  if (c0 < c1) {
+    std::swap(c0, c1);
+    flip = 1;
+  }
+  uint32_t bits = 0;
+  if (c0 != c1)
+    for (int i = 0; i < 16; i++)
+      bits |= (uint32_t) (idx[i] ^ flip) << (i * 2);
+  out[0] = c0 & 0xff;
+  out[1] = c0 >> 8;
+  out[2] = c1 & 0xff;
+  out[3] = c1 >> 8;
+  memcpy(&out[4], &bits, 4);
+}
+
+void encodeColor(const Block &block, uint8_t *out) {
+  float e0[4], e1[4];
+  principalEndpoints(block, 3, e0, e1);
+  uint16_t c0 = to565(e0), c1 = to565(e1);
+  uint8_t idx[16];
+  float err = bc1Indices(block, c0, c1, idx);
+
+  float w[16];
+  for (int i = 0; i < 16; i++)
+    w[i] = bc1Weights[idx[i]];
+  if (err > 0.0f && refineEndpoints(block, w, 3, e0, e1)) {
+    uint16_t r0 = to565(e0), r1 = to565(e1);
+    uint8_t ridx[16];
+    float rerr = bc1Indices(block, r0, r1, ridx);
+    if (rerr < err) {
+      c0 = r0;
+      c1 = r1;
+      memcpy(idx, ridx, 16);
+    }
+  }
+  writeBC1(c0, c1, idx, out);
+}
+
+// -- BC3 alpha block --
+
+void encodeAlpha(const Block &block, uint8_t *out) {
+  float lo = 255.0f, hi = 0.0f;
+  for (int i = 0; i < 16; i++) {
+    lo = std::min(lo, block.px[i][3]);
+    hi = std::max(hi, block.px[i][3]);
+  }
+  int a0 = (int) (hi + 0.5f), a1 = (int) (lo + 0.5f);
+  out[0] = (uint8_t) a0;
+  out[1] = (uint8_t) a1;
+
+  // eight value mode (a0 > a1): 0 = a0, 1 = a1, k = ((8 - k) a0 + (k - 1) a1) / 7
+  uint64_t bits = 0;
+  if (a0 > a1) {
+    float scale = 7.0f / (float) (a0 - a1);
+    for (int i = 0; i < 16; i++) {
+      int t = (int) ((block.px[i][3] - (float) a1) * scale + 0.5f);
+      t = std::clamp(t, 0, 7);
+      uint64_t k = t == 7 ? 0 : t == 0 ? 1 : 8 - t;
+      bits |= k << (i * 3);
+    }
+  }
+  for (int i = 0; i < 6; i++)
+    out[2 + i] = (uint8_t) (bits >> (i * 8));
+}
+
+// -- BC7 mode 6 --
+
+struct Endpoint {
+  int q[4];  // 7 bit
+  int p;     // shared p-bit
+  float v[4];
+};
+
+Endpoint quantize7p(const float *e) {
+  Endpoint best = { };
+  float bestErr = 1e30f;
+  for (int p = 0; p < 2; p++) {
+    Endpoint ep = { };
+    ep.p = p;
+    float err = 0.0f;
+    for (int c = 0; c < 4; c++) {
+      ep.q[c] = std::clamp((int) ((e[c] - p) * 0.5f + 0.5f), 0, 127);
+      ep.v[c] = (float) ((ep.q[c] << 1) | p);
+      err += (ep.v[c] - e[c]) * (ep.v[c] - e[c]);
+    }
+    if (err < bestErr) {
+      bestErr = err;
+      best = ep;
+    }
+  }
+  return best;
+}
+
+float bc7Indices(const Block &block, const Endpoint &a, const Endpoint &b, uint8_t idx[16]) {
+  Palette pal;
+  pal.count = 16;
+  for (int k = 0; k < 16; k++)
+    for (int c = 0; c < 4; c++)
+      pal.c[c][k] = (float) ((((int) a.v[c]) * (64 - bc7Weights[k]) + ((int) b.v[c]) * bc7Weights[k] + 32) >> 6);
+  float total = 0.0f;
+  for (int i = 0; i < 16; i++) {
+    float err;
+    idx[i] = (uint8_t) nearest(pal, block.px[i], 4, err);
+    total += err;
+  }
+  return total;
+}
+
+struct BitWriter {
+  uint8_t *out;
+  int pos = 0;
+  void put(uint32_t value, int count) {
+    for (int i = 0; i < count; i++, pos++)
+      if (value & (1u << i))
+        out[pos >> 3] |= (uint8_t) (1u << (pos & 7));
+  }
+};
+
+void encodeBC7(const Block &block, uint8_t *out) {
+  float e0[4], e1[4];
+  principalEndpoints(block, 4, e0, e1);
+  Endpoint a = quantize7p(e0), b = quantize7p(e1);
+  uint8_t idx[16];
+  float err = bc7Indices(block, a, b, idx);
+
+  float w[16];
+  for (int i = 0; i < 16; i++)
+    w[i] = bc7Weights[idx[i]] / 64.0f;
+  if (err > 0.0f && refineEndpoints(block, w, 4, e0, e1)) {
+    Endpoint ra = quantize7p(e0), rb = quantize7p(e1);
+    uint8_t ridx[16];
+    float rerr = bc7Indices(block, ra, rb, ridx);
+    if (rerr < err) {
+      a = ra;
+      b = rb;
+      memcpy(idx, ridx, 16);
+    }
+  }
+
+  // the anchor (pixel 0) index is stored without its top bit
+  if (idx[0] & 8) {
+    std::swap(a, b);
+    for (int i = 0; i < 16; i++)
+      idx[i] = 15 - idx[i];
+  }
+
+  memset(out, 0, 16);
+  BitWriter bits { out };
+  bits.put(1u << 6, 7);
+  for (int c = 0; c < 4; c++) {
+    bits.put(a.q[c], 7);
+    bits.put(b.q[c], 7);
+  }
+  bits.put(a.p, 1);
+  bits.put(b.p, 1);
+  bits.put(idx[0], 3);
+  for (int i = 1; i < 16; i++)
+    bits.put(idx[i], 4);
+}
+
+void encodeRows(Format format, MyGL_ROImage image, uint8_t *out, uint32_t by0, uint32_t by1) {
+  uint32_t bw = (image.w + 3) / 4;
+  size_t stride = blockBytes(format);
+  Block block;
+  for (uint32_t by = by0; by < by1; by++) {
+    uint8_t *dst = out + (size_t) by * bw * stride;
+    for (uint32_t bx = 0; bx < bw; bx++, dst += stride) {
+      loadBlock(image, bx, by, block);
+      switch (format) {
+        case Format::BC1:
+          encodeColor(block, dst);
+          break;
+        case Format::BC3:
+          encodeAlpha(block, dst);
+          encodeColor(block, dst + 8);
+          break;
+        case Format::BC7:
+          encodeBC7(block, dst);
+          break;
+        default:
+          break;
+      }
+    }
+  }
+}
+
+}
+
+Format formatFor(GLint sizedFormat) {
+  switch (sizedFormat) {
+    case GL_COMPRESSED_RGB_S3TC_DXT1_EXT:
+    case GL_COMPRESSED_SRGB_S3TC_DXT1_EXT:
+      return Format::BC1;
+    case GL_COMPRESSED_RGBA_S3TC_DXT5_EXT:
+    case GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT:
+      return Format::BC3;
+    case GL_COMPRESSED_RGBA_BPTC_UNORM:
+    case GL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM:
+      return Format::BC7;
+    default:
+      return Format::None;
+  }
+}
+
+size_t blockBytes(Format format) {
+  return format == Format::BC1 ? 8 : format == Format::None ? 0 : 16;
+}
+
+size_t encodedSize(Format format, uint32_t w, uint32_t h) {
+  return (size_t) ((w + 3) / 4) * ((h + 3) / 4) * blockBytes(format);
+}
+
+void encode(Format format, MyGL_ROImage image, uint8_t *out, uint32_t threads) {
+  if (format == Format::None || !image.w || !image.h)
+    return;
+  const uint32_t bandRows = 16;
+  uint32_t bh = (image.h + 3) / 4;
+  if (threads == 1 || bh <= bandRows) {
+    encodeRows(format, image, out, 0, bh);
+    return;
+  }
+  utils::TaskGroup tasks(utils::sharedPool(), threads);
+  for (uint32_t by = 0; by < bh; by += bandRows)
+    tasks.enqueue([&, by]() {
+      encodeRows(format, image, out, by, std::min(by + bandRows, bh));
+    });
+  tasks.wait();
+}
+
+}
+
+}
@@ -0,0 +1,28 @@
+#pragma once
+
+#include "public/mygl.h"
+
+namespace mygl {
+
+namespace bc {
+
+enum class Format {
+  None,
+  BC1,  // opaque rgb, 8 bytes per block
+  BC3,  // rgb + interpolated alpha, 16 bytes per block
+  BC7,  // mode 6 only (single subset rgba, 7.7.7.7 + p-bit), 16 bytes per block
+};
+
+// maps a compressed sized format (srgb or not) to its encoder, None for anything else
+Format formatFor(GLint sizedFormat);
+
+size_t blockBytes(Format format);
+size_t encodedSize(Format format, uint32_t w, uint32_t h);
+
+// encodes image into out (encodedSize bytes), partial edge blocks repeat the last row/column
+// threads: 0 = all hardware threads, 1 = calling thread only
+void encode(Format format, MyGL_ROImage image, uint8_t *out, uint32_t threads);
+
+}
+
+}
@@ -81,6 +81,9 @@ struct Vbo : public Bo {
       normalized = GL_FALSE;
     }
     uint32_t sizeInBytes() const {
+      // packed types hold every component in one word
+      if (MYGL_VERTEX_INT_2_10_10_10_REV == type)
+        return 4;
       return sizeOfAttrib(type) * (uint32_t) components;
     }
 
@@ -155,7 +158,7 @@ struct Vbo : public Bo {
     for (size_t i = 0; i < attribs.count; i++) {
       glEnableVertexAttribArray(i);
       auto &attrib = attribs.attribs[i];
-      if (MYGL_VERTEX_FLOAT == attrib.type || attrib.normalized)
+      if (MYGL_VERTEX_FLOAT == attrib.type || MYGL_VERTEX_HALF_FLOAT == attrib.type || MYGL_VERTEX_INT_2_10_10_10_REV == attrib.type || attrib.normalized)
         glVertexAttribPointer(i, (GLint) attrib.components, (GLenum) attrib.type, attrib.normalized, stride, ptr);
       else
         glVertexAttribIPointer(i, (GLint) attrib.components, (GLenum) attrib.type, stride, ptr);
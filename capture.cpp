@@ -0,0 +1,301 @@
+#include "utils/log.h"
+#include "utils/threads.h"
+#include "utils/bitmap.h"
+#include "utils/thirdparty/miniz/miniz.h"
+
+#include "capture.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <list>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace mygl {
+
+namespace capture {
+
+namespace {
+
+const size_t bandBytes = 512 * 1024;  // filtered png bytes per deflate job
+const size_t maxFreePbos = 4;
+
+enum State {
+  Reading,
+  Encoding,
+  Done,
+  Failed,
+};
+
+struct Pbo {
+  GLuint id;
+  size_t size;
+  const uint8_t *mapped;  // persistent mapping, nullptr without ARB_buffer_storage
+};
+
+// a run of png rows deflated on its own, the runs are stitched into one zlib stream
+struct Band {
+  uint32_t y0, y1;
+  std::vector<uint8_t> deflated;
+  uint32_t adler;
+  size_t rawSize;
+};
+
+struct Capture {
+  std::string path;
+  MyGL_CaptureFormat format;
+  uint32_t w, h;
+  MyGL_CaptureFunc done;
+  void *user;
+
+  Pbo pbo = { };
+  GLsync fence = nullptr;
+  const uint8_t *pixels = nullptr;  // BGRA rows bottom-up, the mapped PBO or copy
+  std::vector<uint8_t> copy;
+
+  std::vector<Band> bands;
+  std::atomic<uint32_t> pending { 0 };
+  std::atomic<int> state { Reading };
+};
+
+std::unique_ptr<utils::ThreadPool> workers;
+std::list<std::shared_ptr<Capture> > captures;
+std::vector<Pbo> freePbos;
+
+Pbo acquire(size_t size) {
+  for (size_t i = 0; i < freePbos.size(); i++) {
+    if (freePbos[i].size >= size) {
+      Pbo pbo = freePbos[i];
+      freePbos.erase(freePbos.begin() + i);
+      return pbo;
+    }
+  }
+  Pbo pbo = { .id = 0, .size = size, .mapped = nullptr };
+  glGenBuffers(1, &pbo.id);
+  glBindBuffer( GL_PIXEL_PACK_BUFFER, pbo.id);
+  if (GLEW_ARB_buffer_storage) {
+    GLbitfield flags = GL_MAP_READ_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+    glBufferStorage( GL_PIXEL_PACK_BUFFER, size, nullptr, flags);
+    pbo.mapped = (const uint8_t*) glMapBufferRange( GL_PIXEL_PACK_BUFFER, 0, size, flags);
+  } else {
+    glBufferData( GL_PIXEL_PACK_BUFFER, size, nullptr, GL_STREAM_READ);
+  }
+  glBindBuffer( GL_PIXEL_PACK_BUFFER, 0);
+  return pbo;
+}
+
+void release(Pbo &pbo) {
+  if (!pbo.id)
+    return;
+  if (freePbos.size() < maxFreePbos) {
+    freePbos.push_back(pbo);
+  } else {
+    if (pbo.mapped) {
+      glBindBuffer( GL_PIXEL_PACK_BUFFER, pbo.id);
+      glUnmapBuffer( GL_PIXEL_PACK_BUFFER);
+      glBindBuffer( GL_PIXEL_PACK_BUFFER, 0);
+    }
+    glDeleteBuffers(1, &pbo.id);
+  }
+  pbo = { };
+}
+
+mz_bool append(const void *data, int len, void *user) {
+  auto *out = (std::vector<uint8_t>*) user;
+  out->insert(out->end(), (const uint8_t*) data, (const uint8_t*) data + len);
+  return MZ_TRUE;
+}
+
+// zlib's adler32_combine: the checksum of a || b from the checksums of a and b
+uint32_t adlerCombine(uint32_t a, uint32_t b, size_t lenB) {
+  const uint32_t base = 65521;
+  uint32_t rem = (uint32_t) (lenB % base);
+  uint32_t sum1 = a & 0xffff;
+  uint32_t sum2 = (uint32_t) (((uint64_t) rem * sum1) % base);
+  sum1 += (b & 0xffff) + base - 1;
+  sum2 += (a >> 16) + (b >> 16) + base - rem;
+  if (sum1 >= base)
+    sum1 -= base;
+  if (sum1 >= base)
+    sum1 -= base;
+  if (sum2 >= (base << 1))
+    sum2 -= (base << 1);
+  if (sum2 >= base)
+    sum2 -= base;
+  return sum1 | (sum2 << 16);
+}
+
+// png rows top-down as RGB with the Sub filter, then a fast raw deflate ending on a byte boundary
+void deflateBand(Capture &capture, Band &band, bool last) {
+  size_t rowBytes = 1 + (size_t) capture.w * 3;
+  std::vector<uint8_t> raw(rowBytes * (band.y1 - band.y0));
+  uint8_t *out = raw.data();
+  for (uint32_t y = band.y0; y < band.y1; y++) {
+    const uint8_t *in = capture.pixels + (size_t) (capture.h - 1 - y) * capture.w * 4;
+    *out++ = 1;
+    uint8_t prev[3] = { 0, 0, 0 };
+    for (uint32_t x = 0; x < capture.w; x++, in += 4, out += 3) {
+      uint8_t rgb[3] = { in[2], in[1], in[0] };
+      for (int c = 0; c < 3; c++) {
+        out[c] = rgb[c] - prev[c];
+        prev[c] = rgb[c];
+      }
+    }
+  }
+  band.rawSize = raw.size();
+  band.adler = (uint32_t) mz_adler32(MZ_ADLER32_INIT, raw.data(), raw.size());
+
+  auto compressor = std::make_unique<tdefl_compressor>();
+  tdefl_init(compressor.get(), append, &band.deflated, (int) tdefl_create_comp_flags_from_zip_params(MZ_BEST_SPEED, -MZ_DEFAULT_WINDOW_BITS, MZ_DEFAULT_STRATEGY));
+  tdefl_compress_buffer(compressor.get(), raw.data(), raw.size(), last ? TDEFL_FINISH : TDEFL_SYNC_FLUSH);
+}
+
+bool writeChunk(FILE *fp, const char *type, const uint8_t *data, size_t size) {
+  uint8_t length[4] = { (uint8_t) (size >> 24), (uint8_t) (size >> 16), (uint8_t) (size >> 8), (uint8_t) size };
+  uint32_t crc = (uint32_t) mz_crc32(MZ_CRC32_INIT, (const uint8_t*) type, 4);
+  crc = (uint32_t) mz_crc32(crc, data, size);
+  uint8_t crcBytes[4] = { (uint8_t) (crc >> 24), (uint8_t) (crc >> 16), (uint8_t) (crc >> 8), (uint8_t) crc };
+  bool ok = fwrite(length, 4, 1, fp) == 1 && fwrite(type, 4, 1, fp) == 1;
+  ok = ok && (!size || fwrite(data, size, 1, fp) == 1);
+  return ok && fwrite(crcBytes, 4, 1, fp) == 1;
+}
+
+bool writePng(Capture &capture) {
+  // fastest-level zlib header, the bands' raw deflate blocks and the combined checksum
+  std::vector<uint8_t> idat = { 0x78, 0x01 };
+  uint32_t adler = capture.bands[0].adler;
+  for (size_t i = 0; i < capture.bands.size(); i++) {
+    Band &band = capture.bands[i];
+    idat.insert(idat.end(), band.deflated.begin(), band.deflated.end());
+    if (i)
+      adler = adlerCombine(adler, band.adler, band.rawSize);
+    band.deflated = { };
+  }
+  for (int shift = 24; shift >= 0; shift -= 8)
+    idat.push_back((uint8_t) (adler >> shift));
+
+  FILE *fp = fopen(capture.path.c_str(), "wb");
+  if (!fp) {
+    utils::logout("%s error: cannot write '%s'", __func__, capture.path.c_str());
+    return false;
+  }
+  const uint8_t signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n' };
+  uint32_t w = capture.w, h = capture.h;
+  const uint8_t header[13] = { (uint8_t) (w >> 24), (uint8_t) (w >> 16), (uint8_t) (w >> 8), (uint8_t) w, (uint8_t) (h >> 24), (uint8_t) (h >> 16), (uint8_t) (h >> 8),
+      (uint8_t) h, 8, 2, 0, 0, 0 };  // 8 bit RGB, no interlacing
+  bool ok = fwrite(signature, 8, 1, fp) == 1;
+  ok = ok && writeChunk(fp, "IHDR", header, sizeof(header));
+  ok = ok && writeChunk(fp, "IDAT", idat.data(), idat.size());
+  ok = ok && writeChunk(fp, "IEND", nullptr, 0);
+  ok = !fclose(fp) && ok;
+  if (!ok)
+    utils::logout("%s error: cannot write '%s'", __func__, capture.path.c_str());
+  return ok;
+}
+
+void finish(Capture &capture, bool ok) {
+  capture.state.store(ok ? Done : Failed, std::memory_order_release);
+}
+
+// worker side, the pixels are readable from here on
+void encode(std::shared_ptr<Capture> capture) {
+  if (capture->format == MYGL_CAPTURE_BMP) {
+    workers->enqueue([capture]() {
+      finish(*capture, utils::bmp::writeBitmapFile(capture->path.c_str(), capture->pixels, capture->w, capture->h));
+    });
+    return;
+  }
+
+  // bands go out as separate jobs, whichever finishes last stitches them together and writes the file
+  uint32_t rows = std::max<uint32_t>(1, bandBytes / (1 + capture->w * 3));
+  for (uint32_t y = 0; y < capture->h; y += rows)
+    capture->bands.push_back(Band { .y0 = y, .y1 = std::min(y + rows, capture->h), .deflated = { }, .adler = 0, .rawSize = 0 });
+  capture->pending = (uint32_t) capture->bands.size();
+  for (size_t i = 0; i < capture->bands.size(); i++) {
+    workers->enqueue([capture, i]() {
+      deflateBand(*capture, capture->bands[i], i + 1 == capture->bands.size());
+      if (1 == capture->pending.fetch_sub(1))
+        finish(*capture, writePng(*capture));
+    });
+  }
+}
+
+}
+
+bool request(int x, int y, uint32_t w, uint32_t h, MyGL_CaptureFormat format, const char *path, MyGL_CaptureFunc done, void *user) {
+  if (!workers)
+    workers = std::make_unique<utils::ThreadPool>();
+
+  auto capture = std::make_shared<Capture>();
+  capture->path = path;
+  capture->format = format;
+  capture->w = w;
+  capture->h = h;
+  capture->done = done;
+  capture->user = user;
+  capture->pbo = acquire((size_t) w * h * 4);
+
+  glBindBuffer( GL_PIXEL_PACK_BUFFER, capture->pbo.id);
+  glReadPixels(x, y, w, h, GL_BGRA, GL_UNSIGNED_BYTE, nullptr);
+  glBindBuffer( GL_PIXEL_PACK_BUFFER, 0);
+  capture->fence = glFenceSync( GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+  captures.push_back(capture);
+  return true;
+}
+
+uint32_t pump() {
+  for (auto it = captures.begin(); it != captures.end();) {
+    auto capture = *it;
+    int state = capture->state.load(std::memory_order_acquire);
+    if (state == Reading) {
+      if (glClientWaitSync(capture->fence, 0, 0) != GL_TIMEOUT_EXPIRED) {
+        glDeleteSync(capture->fence);
+        capture->fence = nullptr;
+        if (capture->pbo.mapped) {
+          capture->pixels = capture->pbo.mapped;
+        } else {
+          // no persistent mapping, the one copy happens here
+          size_t size = (size_t) capture->w * capture->h * 4;
+          glBindBuffer( GL_PIXEL_PACK_BUFFER, capture->pbo.id);
+          const void *mapped = glMapBufferRange( GL_PIXEL_PACK_BUFFER, 0, size, GL_MAP_READ_BIT);
+          if (mapped) {
+            capture->copy.assign((const uint8_t*) mapped, (const uint8_t*) mapped + size);
+            glUnmapBuffer( GL_PIXEL_PACK_BUFFER);
+          }
+          glBindBuffer( GL_PIXEL_PACK_BUFFER, 0);
+          release(capture->pbo);
+          capture->pixels = capture->copy.empty() ? nullptr : capture->copy.data();
+        }
+        if (capture->pixels) {
+          capture->state.store(Encoding, std::memory_order_relaxed);
+          encode(capture);
+        } else {
+          // reported through done on the next pump
+          utils::logout("%s error: cannot map the pixels of capture '%s'", __func__, capture->path.c_str());
+          capture->state.store(Failed, std::memory_order_relaxed);
+        }
+      }
+      ++it;
+      continue;
+    }
+    if (state == Encoding) {
+      ++it;
+      continue;
+    }
+
+    release(capture->pbo);
+    if (MyGL_Debug_getChatty())
+      utils::logout("%s - capture '%s' %s", __func__, capture->path.c_str(), state == Done ? "written" : "failed");
+    if (capture->done)
+      capture->done(capture->user, capture->path.c_str(), state == Done);
+    it = captures.erase(it);
+  }
+  return (uint32_t) captures.size();
+}
+
+}
+
+}
@@ -0,0 +1,17 @@
+#pragma once
+
+#include "public/mygl.h"
+
+namespace mygl {
+
+// frame captures: readback into a PBO, flip/swizzle/encode/write on worker threads, callback on the GL thread
+namespace capture {
+
+bool request(int x, int y, uint32_t w, uint32_t h, MyGL_CaptureFormat format, const char *path, MyGL_CaptureFunc done, void *user);
+
+// GL thread only, returns the number of captures not written yet
+uint32_t pump();
+
+}
+
+}
@@ -7,68 +7,74 @@ namespace mygl {
 
 // @formatter:off
 static const MyGL_ColorFormat colorFormats[] = {
-    { "GL_R8", GL_R8, GL_RED, 8, 0, 0, 0, 0, 0 },
-    { "GL_R8_SNORM", GL_R8_SNORM, GL_RED, 8, 0, 0, 0, 0, 0 },
-    { "GL_R16", GL_R16, GL_RED, 16, 0, 0, 0, 0, 0 },
-    { "GL_R16_SNORM", GL_R16_SNORM, GL_RED, 16, 0, 0, 0, 0, 0 },
-    { "GL_RG8", GL_RG8, GL_RG, 8, 8, 0, 0, 0, 0 },
-    { "GL_RG8_SNORM", GL_RG8_SNORM, GL_RG, 8, 8, 0, 0, 0, 0 },
-    { "GL_RG16", GL_RG16, GL_RG, 16, 16, 0, 0, 0, 0 },
-    { "GL_RG16_SNORM", GL_RG16_SNORM, GL_RG, 16, 16, 0, 0, 0, 0 },
-    { "GL_R3_G3_B2", GL_R3_G3_B2, GL_RGB, 3, 3, 2, 0, 0, 0 },
-    { "GL_RGB4", GL_RGB4, GL_RGB, 4, 4, 4, 0, 0, 0 },
-    { "GL_RGB5", GL_RGB5, GL_RGB, 5, 5, 5, 0, 0, 0 },
-    { "GL_RGB8", GL_RGB8, GL_RGB, 8, 8, 8, 0, 0, 0 },
-    { "GL_RGB8_SNORM", GL_RGB8_SNORM, GL_RGB, 8, 8, 8, 0, 0, 0 },
-    { "GL_RGB10", GL_RGB10, GL_RGB, 10, 10, 10, 0, 0, 0 },
-    { "GL_RGB12", GL_RGB12, GL_RGB, 12, 12, 12, 0, 0, 0 },
-    { "GL_RGB16_SNORM", GL_RGB16_SNORM, GL_RGB, 16, 16, 16, 0, 0, 0 },
-    { "GL_RGBA2", GL_RGBA2, GL_RGB, 2, 2, 2, 2, 0, 0 },
-    { "GL_RGBA4", GL_RGBA4, GL_RGB, 4, 4, 4, 4, 0, 0 },
-    { "GL_RGB5_A1", GL_RGB5_A1, GL_RGBA, 5, 5, 5, 1, 0, 0 },
-    { "GL_RGBA8", GL_RGBA8, GL_RGBA, 8, 8, 8, 8, 0, 0 },
-    { "GL_RGBA8_SNORM", GL_RGBA8_SNORM, GL_RGBA, 8, 8, 8, 8, 0, 0 },
-    { "GL_RGB10_A2", GL_RGB10_A2, GL_RGBA, 10, 10, 10, 2, 0, 0 },
-    { "GL_RGB10_A2UI", GL_RGB10_A2UI, GL_RGBA, 10, 10, 10, 2, 0, 0 },
-    { "GL_RGBA12", GL_RGBA12, GL_RGBA, 12, 12, 12, 12, 0, 0 },
-    { "GL_RGBA16", GL_RGBA16, GL_RGBA, 16, 16, 16, 16, 0, 0 },
-    { "GL_SRGB8", GL_SRGB8, GL_RGB, 8, 8, 8, 0, 0, 0 },
-    { "GL_SRGB8_ALPHA8", GL_SRGB8_ALPHA8, GL_RGBA, 8, 8, 8, 8, 0, 0 },
-    { "GL_R16F", GL_R16F, GL_RED, 16, 0, 0, 0, 0, 0 },
-    { "GL_RG16F", GL_RG16F, GL_RG, 16, 16, 0, 0, 0, 0 },
-    { "GL_RGB16F", GL_RGB16F, GL_RGB, 16, 16, 16, 0, 0, 0 },
-    { "GL_RGBA16F", GL_RGBA16F, GL_RGBA, 16, 16, 16, 16, 0, 0 },
-    { "GL_R32F", GL_R32F, GL_RED, 32, 0, 0, 0, 0, 0 },
-    { "GL_RG32F", GL_RG32F, GL_RG, 32, 32, 0, 0, 0, 0 },
-    { "GL_RGB32F", GL_RGB32F, GL_RGB, 32, 32, 32, 0, 0, 0 },
-    { "GL_RGBA32F", GL_RGBA32F, GL_RGBA, 32, 32, 32, 32, 0, 0 },
-    { "GL_R11F_G11F_B10F", GL_R11F_G11F_B10F, GL_RGB, 11, 11, 10, 0, 0, 0 },
-    { "GL_RGB9_E5", GL_RGB9_E5, GL_RGB, 9, 9, 9, 5, 0, 0 },
-    { "GL_R8I", GL_R8I, GL_RED, 8, 0, 0, 0, 0, 0 },
-    { "GL_R8UI", GL_R8UI, GL_RED, 8, 0, 0, 0, 0, 0 },
-    { "GL_R16I", GL_R16I, GL_RED, 16, 0, 0, 0, 0, 0 },
-    { "GL_R16UI", GL_R16UI, GL_RED, 16, 0, 0, 0, 0, 0 },
-    { "GL_R32I", GL_R32I, GL_RED, 32, 0, 0, 0, 0, 0 },
-    { "GL_R32UI", GL_R32UI, GL_RED, 32, 0, 0, 0, 0, 0 },
-    { "GL_RG8I", GL_RG8I, GL_RG, 8, 8, 0, 0, 0, 0 },
-    { "GL_RG8UI", GL_RG8UI, GL_RG, 8, 8, 0, 0, 0, 0 },
-    { "GL_RG16I", GL_RG16I, GL_RG, 16, 16, 0, 0, 0, 0 },
-    { "GL_RG16UI", GL_RG16UI, GL_RG, 16, 16, 0, 0, 0, 0 },
-    { "GL_RG32I", GL_RG32I, GL_RG, 32, 32, 0, 0, 0, 0 },
-    { "GL_RG32UI", GL_RG32UI, GL_RG, 32, 32, 0, 0, 0, 0 },
-    { "GL_RGB8I", GL_RGB8I, GL_RGB, 8, 8, 8, 0, 0, 0 },
-    { "GL_RGB8UI", GL_RGB8UI, GL_RGB, 8, 8, 8, 0, 0, 0 },
-    { "GL_RGB16I", GL_RGB16I, GL_RGB, 16, 16, 16, 0, 0, 0 },
-    { "GL_RGB16UI", GL_RGB16UI, GL_RGB, 16, 16, 16, 0, 0, 0 },
-    { "GL_RGB32I", GL_RGB32I, GL_RGB, 32, 32, 32, 0, 0, 0 },
-    { "GL_RGB32UI", GL_RGB32UI, GL_RGB, 32, 32, 32, 0, 0, 0 },
-    { "GL_RGBA8I", GL_RGBA8I, GL_RGBA, 8, 8, 8, 8, 0, 0 },
-    { "GL_RGBA8UI", GL_RGBA8UI, GL_RGBA, 8, 8, 8, 8, 0, 0 },
-    { "GL_RGBA16I", GL_RGBA16I, GL_RGBA, 16, 16, 16, 16, 0, 0 },
-    { "GL_RGBA16UI", GL_RGBA16UI, GL_RGBA, 16, 16, 16, 16, 0, 0 },
-    { "GL_RGBA32I", GL_RGBA32I, GL_RGBA, 32, 32, 32, 32, 0, 0 },
-    { "GL_RGBA32UI", GL_RGBA32UI, GL_RGBA, 32, 32, 32, 32, 0, 0 },
-    { "GL_DEPTH24_STENCIL8", GL_DEPTH24_STENCIL8, GL_DEPTH_STENCIL, 0, 0, 0, 0, 24, 8 },
+    { "GL_R8", GL_R8, GL_RED, 8, 0, 0, 0, 0, 0, 0 },
+    { "GL_R8_SNORM", GL_R8_SNORM, GL_RED, 8, 0, 0, 0, 0, 0, 0 },
+    { "GL_R16", GL_R16, GL_RED, 16, 0, 0, 0, 0, 0, 0 },
+    { "GL_R16_SNORM", GL_R16_SNORM, GL_RED, 16, 0, 0, 0, 0, 0, 0 },
+    { "GL_RG8", GL_RG8, GL_RG, 8, 8, 0, 0, 0, 0, 0 },
+    { "GL_RG8_SNORM", GL_RG8_SNORM, GL_RG, 8, 8, 0, 0, 0, 0, 0 },
+    { "GL_RG16", GL_RG16, GL_RG, 16, 16, 0, 0, 0, 0, 0 },
+    { "GL_RG16_SNORM", GL_RG16_SNORM, GL_RG, 16, 16, 0, 0, 0, 0, 0 },
+    { "GL_R3_G3_B2", GL_R3_G3_B2, GL_RGB, 3, 3, 2, 0, 0, 0, 0 },
+    { "GL_RGB4", GL_RGB4, GL_RGB, 4, 4, 4, 0, 0, 0, 0 },
+    { "GL_RGB5", GL_RGB5, GL_RGB, 5, 5, 5, 0, 0, 0, 0 },
+    { "GL_RGB8", GL_RGB8, GL_RGB, 8, 8, 8, 0, 0, 0, 0 },
+    { "GL_RGB8_SNORM", GL_RGB8_SNORM, GL_RGB, 8, 8, 8, 0, 0, 0, 0 },
+    { "GL_RGB10", GL_RGB10, GL_RGB, 10, 10, 10, 0, 0, 0, 0 },
+    { "GL_RGB12", GL_RGB12, GL_RGB, 12, 12, 12, 0, 0, 0, 0 },
+    { "GL_RGB16_SNORM", GL_RGB16_SNORM, GL_RGB, 16, 16, 16, 0, 0, 0, 0 },
+    { "GL_RGBA2", GL_RGBA2, GL_RGB, 2, 2, 2, 2, 0, 0, 0 },
+    { "GL_RGBA4", GL_RGBA4, GL_RGB, 4, 4, 4, 4, 0, 0, 0 },
+    { "GL_RGB5_A1", GL_RGB5_A1, GL_RGBA, 5, 5, 5, 1, 0, 0, 0 },
+    { "GL_RGBA8", GL_RGBA8, GL_RGBA, 8, 8, 8, 8, 0, 0, 0 },
+    { "GL_RGBA8_SNORM", GL_RGBA8_SNORM, GL_RGBA, 8, 8, 8, 8, 0, 0, 0 },
+    { "GL_RGB10_A2", GL_RGB10_A2, GL_RGBA, 10, 10, 10, 2, 0, 0, 0 },
+    { "GL_RGB10_A2UI", GL_RGB10_A2UI, GL_RGBA, 10, 10, 10, 2, 0, 0, 0 },
+    { "GL_RGBA12", GL_RGBA12, GL_RGBA, 12, 12, 12, 12, 0, 0, 0 },
+    { "GL_RGBA16", GL_RGBA16, GL_RGBA, 16, 16, 16, 16, 0, 0, 0 },
+    { "GL_SRGB8", GL_SRGB8, GL_RGB, 8, 8, 8, 0, 0, 0, 0 },
+    { "GL_SRGB8_ALPHA8", GL_SRGB8_ALPHA8, GL_RGBA, 8, 8, 8, 8, 0, 0, 0 },
+    { "GL_R16F", GL_R16F, GL_RED, 16, 0, 0, 0, 0, 0, 0 },
+    { "GL_RG16F", GL_RG16F, GL_RG, 16, 16, 0, 0, 0, 0, 0 },
+    { "GL_RGB16F", GL_RGB16F, GL_RGB, 16, 16, 16, 0, 0, 0, 0 },
+    { "GL_RGBA16F", GL_RGBA16F, GL_RGBA, 16, 16, 16, 16, 0, 0, 0 },
+    { "GL_R32F", GL_R32F, GL_RED, 32, 0, 0, 0, 0, 0, 0 },
+    { "GL_RG32F", GL_RG32F, GL_RG, 32, 32, 0, 0, 0, 0, 0 },
+    { "GL_RGB32F", GL_RGB32F, GL_RGB, 32, 32, 32, 0, 0, 0, 0 },
+    { "GL_RGBA32F", GL_RGBA32F, GL_RGBA, 32, 32, 32, 32, 0, 0, 0 },
+    { "GL_R11F_G11F_B10F", GL_R11F_G11F_B10F, GL_RGB, 11, 11, 10, 0, 0, 0, 0 },
+    { "GL_RGB9_E5", GL_RGB9_E5, GL_RGB, 9, 9, 9, 5, 0, 0, 0 },
+    { "GL_R8I", GL_R8I, GL_RED, 8, 0, 0, 0, 0, 0, 0 },
+    { "GL_R8UI", GL_R8UI, GL_RED, 8, 0, 0, 0, 0, 0, 0 },
+    { "GL_R16I", GL_R16I, GL_RED, 16, 0, 0, 0, 0, 0, 0 },
+    { "GL_R16UI", GL_R16UI, GL_RED, 16, 0, 0, 0, 0, 0, 0 },
+    { "GL_R32I", GL_R32I, GL_RED, 32, 0, 0, 0, 0, 0, 0 },
+    { "GL_R32UI", GL_R32UI, GL_RED, 32, 0, 0, 0, 0, 0, 0 },
+    { "GL_RG8I", GL_RG8I, GL_RG, 8, 8, 0, 0, 0, 0, 0 },
+    { "GL_RG8UI", GL_RG8UI, GL_RG, 8, 8, 0, 0, 0, 0, 0 },
+    { "GL_RG16I", GL_RG16I, GL_RG, 16, 16, 0, 0, 0, 0, 0 },
+    { "GL_RG16UI", GL_RG16UI, GL_RG, 16, 16, 0, 0, 0, 0, 0 },
+    { "GL_RG32I", GL_RG32I, GL_RG, 32, 32, 0, 0, 0, 0, 0 },
+    { "GL_RG32UI", GL_RG32UI, GL_RG, 32, 32, 0, 0, 0, 0, 0 },
+    { "GL_RGB8I", GL_RGB8I, GL_RGB, 8, 8, 8, 0, 0, 0, 0 },
+    { "GL_RGB8UI", GL_RGB8UI, GL_RGB, 8, 8, 8, 0, 0, 0, 0 },
+    { "GL_RGB16I", GL_RGB16I, GL_RGB, 16, 16, 16, 0, 0, 0, 0 },
+    { "GL_RGB16UI", GL_RGB16UI, GL_RGB, 16, 16, 16, 0, 0, 0, 0 },
+    { "GL_RGB32I", GL_RGB32I, GL_RGB, 32, 32, 32, 0, 0, 0, 0 },
+    { "GL_RGB32UI", GL_RGB32UI, GL_RGB, 32, 32, 32, 0, 0, 0, 0 },
+    { "GL_RGBA8I", GL_RGBA8I, GL_RGBA, 8, 8, 8, 8, 0, 0, 0 },
+    { "GL_RGBA8UI", GL_RGBA8UI, GL_RGBA, 8, 8, 8, 8, 0, 0, 0 },
+    { "GL_RGBA16I", GL_RGBA16I, GL_RGBA, 16, 16, 16, 16, 0, 0, 0 },
+    { "GL_RGBA16UI", GL_RGBA16UI, GL_RGBA, 16, 16, 16, 16, 0, 0, 0 },
+    { "GL_RGBA32I", GL_RGBA32I, GL_RGBA, 32, 32, 32, 32, 0, 0, 0 },
+    { "GL_RGBA32UI", GL_RGBA32UI, GL_RGBA, 32, 32, 32, 32, 0, 0, 0 },
+    { "GL_DEPTH24_STENCIL8", GL_DEPTH24_STENCIL8, GL_DEPTH_STENCIL, 0, 0, 0, 0, 24, 8, 0 },
+    { "GL_BC1_RGB", GL_COMPRESSED_RGB_S3TC_DXT1_EXT, GL_RGB, 5, 6, 5, 0, 0, 0, 8 },
+    { "GL_BC3_RGBA", GL_COMPRESSED_RGBA_S3TC_DXT5_EXT, GL_RGBA, 5, 6, 5, 8, 0, 0, 16 },
+    { "GL_BC7_RGBA", GL_COMPRESSED_RGBA_BPTC_UNORM, GL_RGBA, 8, 8, 8, 8, 0, 0, 16 },
+    { "GL_BC1_SRGB", GL_COMPRESSED_SRGB_S3TC_DXT1_EXT, GL_RGB, 5, 6, 5, 0, 0, 0, 8 },
+    { "GL_BC3_SRGB_ALPHA", GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT, GL_RGBA, 5, 6, 5, 8, 0, 0, 16 },
+    { "GL_BC7_SRGB_ALPHA", GL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM, GL_RGBA, 8, 8, 8, 8, 0, 0, 16 },
 };
 
 const std::map<std::string, const MyGL_ColorFormat& > colorFormatByNames = {
@@ -134,6 +140,12 @@ const std::map<std::string, const MyGL_ColorFormat& > colorFormatByNames = {
     { "rgba32i", colorFormats[59] },
     { "rgba32ui", colorFormats[60] },
     { "depth24stencil8", colorFormats[61] },
+    { "bc1", colorFormats[62] },
+    { "bc3", colorFormats[63] },
+    { "bc7", colorFormats[64] },
+    { "bc1srgb", colorFormats[65] },
+    { "bc3srgb", colorFormats[66] },
+    { "bc7srgb", colorFormats[67] },
 };
 // @formatter:on
 
@@ -1,15 +1,110 @@
 #include "utils/bitmap.h"
+#include "utils/threads.h"
 #include "utils/log.h"
+#include "utils/pixels.h"
 #include "utils/thirdparty/lodepng/lodepng.h"
+#include "utils/thirdparty/miniz/miniz.h"
 
 #include "image.h"
+#include "resample.h"
+#include <algorithm>
+#include <atomic>
 #include <cstring>
+#include <functional>
 #include <vector>
 
-template<typename T> void swap(T &a, T &b) {
-  T t = a;
-  a = b;
-  b = t;
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#endif
+
+namespace mygl {
+
+namespace {
+
+// box-filter a cols x rows footprint, integer sums truncate the same way MyGL_imageSampleBox does
+inline MyGL_Color reduceBox(const MyGL_Color *p, uint32_t pitch, uint32_t cols, uint32_t rows) {
+  uint32_t sum[4] = { 0, 0, 0, 0 };
+  for (uint32_t y = 0; y < rows; y++)
+    for (uint32_t x = 0; x < cols; x++) {
+      const MyGL_Color &c = p[y * pitch + x];
+      sum[0] += c.rgba[0];
+      sum[1] += c.rgba[1];
+      sum[2] += c.rgba[2];
+      sum[3] += c.rgba[3];
+    }
+  uint32_t count = cols * rows;
+  MyGL_Color c;
+  for (int i = 0; i < 4; i++)
+    c.rgba[i] = (uint8_t) (sum[i] / count);
+  return c;
+}
+
+// 2x2 reduction of two source rows, returns the no. of output pixels written
+inline uint32_t reduce2x2(const MyGL_Color *row0, const MyGL_Color *row1, MyGL_Color *out, uint32_t count) {
+  uint32_t x = 0;
+#if defined(__AVX2__)
+  const __m256i zero = _mm256_setzero_si256();
+  auto half = [&](const MyGL_Color *a, const MyGL_Color *b) {
+    __m256i va = _mm256_loadu_si256((const __m256i*) a);
+    __m256i vb = _mm256_loadu_si256((const __m256i*) b);
+    __m256i lo = _mm256_add_epi16(_mm256_unpacklo_epi8(va, zero), _mm256_unpacklo_epi8(vb, zero));
+    __m256i hi = _mm256_add_epi16(_mm256_unpackhi_epi8(va, zero), _mm256_unpackhi_epi8(vb, zero));
+    lo = _mm256_add_epi16(lo, _mm256_srli_si256(lo, 8));
+    hi = _mm256_add_epi16(hi, _mm256_srli_si256(hi, 8));
+    return _mm256_srli_epi16(_mm256_unpacklo_epi64(lo, hi), 2);
+  };
+  for (; x + 8 <= count; x += 8) {
+    __m256i a = half(&row0[x * 2], &row1[x * 2]);
+    __m256i b = half(&row0[x * 2 + 8], &row1[x * 2 + 8]);
+    __m256i packed = _mm256_permute4x64_epi64(_mm256_packus_epi16(a, b), _MM_SHUFFLE(3, 1, 2, 0));
+    _mm256_storeu_si256((__m256i*) &out[x], packed);
+  }
+#elif defined(__SSE2__) || defined(_M_X64)
+  const __m128i zero = _mm_setzero_si128();
+  auto half = [&](const MyGL_Color *a, const MyGL_Color *b) {
+    __m128i va = _mm_loadu_si128((const __m128i*) a);
+    __m128i vb = _mm_loadu_si128((const __m128i*) b);
+    __m128i lo = _mm_add_epi16(_mm_unpacklo_epi8(va, zero), _mm_unpacklo_epi8(vb, zero));
+    __m128i hi = _mm_add_epi16(_mm_unpackhi_epi8(va, zero), _mm_unpackhi_epi8(vb, zero));
+    lo = _mm_add_epi16(lo, _mm_srli_si128(lo, 8));
+    hi = _mm_add_epi16(hi, _mm_srli_si128(hi, 8));
+    return _mm_srli_epi16(_mm_unpacklo_epi64(lo, hi), 2);
+  };
+  for (; x + 4 <= count; x += 4) {
+    __m128i a = half(&row0[x * 2], &row1[x * 2]);
+    __m128i b = half(&row0[x * 2 + 4], &row1[x * 2 + 4]);
+    _mm_storeu_si128((__m128i*) &out[x], _mm_packus_epi16(a, b));
+  }
+#endif
+  for (; x < count; x++)
+    out[x] = reduceBox(&row0[x * 2], (uint32_t) (row1 - row0), 2, 2);
+  return x;
+}
+
+}
+
+void mipRows(MyGL_ROImage src, uint32_t srcPitch, MyGL_Image dst, uint32_t y0, uint32_t y1) {
+  uint32_t sx = src.w > 1 ? 2 : 1;
+  uint32_t sy = src.h > 1 ? 2 : 1;
+  bool oddw = src.w > 1 && (src.w & 0x01);
+  bool oddh = src.h > 1 && (src.h & 0x01);
+
+  for (uint32_t y = y0; y < y1; y++) {
+    uint32_t rows = oddh && y == dst.h - 1 ? 3 : sy;
+    const MyGL_Color *in = &src.pixels[(size_t) y * sy * srcPitch];
+    MyGL_Color *out = &dst.pixels[(size_t) y * dst.w];
+    uint32_t x = 0;
+    if (2 == sx && 2 == rows)
+      x = reduce2x2(in, in + srcPitch, out, oddw ? dst.w - 1 : dst.w);
+    for (; x < dst.w; x++) {
+      uint32_t cols = oddw && x == dst.w - 1 ? 3 : sx;
+      out[x] = reduceBox(&in[x * sx], srcPitch, cols, rows);
+    }
+  }
+}
+
 }
 
 MyGL_Color MyGL_color(uint8_t r, uint8_t g, uint8_t b, uint8_t a) {
@@ -107,108 +202,472 @@ MyGL_Image MyGL_imageMip(MyGL_ROImage image) {
   if (image.w == 1 && image.h == 1)
     return out;
 
-  if (1 == image.w) {
-    out = MyGL_imageAlloc(1, image.h / 2);
-    bool oddh = (image.h & 0x01) > 0;
-    for (uint32_t y = 0; y < out.w; y++) {
-      bool endy = y == (out.h - 1);
-      auto h = oddh && endy ? 3 : 2;
-      out.pixels[y] = MyGL_imageSampleBox(image, 0, y * 2, 1, h);
-    }
+  out = MyGL_imageAlloc(image.w / 2, image.h / 2);
+  mygl::mipRows(image, image.w, out, 0, out.h);
+  return out;
+}
+
+MyGL_Image MyGL_imageResize(MyGL_ROImage image, uint32_t w, uint32_t h, MyGL_ImageFilter filter) {
+  MyGL_Image out = { 0, 0, nullptr };
+  if (!image.w || !image.h || !image.pixels || !w || !h)
     return out;
+
+  out = MyGL_imageAlloc(w, h);
+  mygl::resample::resize(image, out, filter, false, 0);
+  return out;
+}
+
+namespace mygl {
+
+namespace {
+
+size_t mipChainPixels(uint32_t w, uint32_t h, bool withLevel0) {
+  size_t total = withLevel0 ? (size_t) w * h : 0;
+  while (w > 1 || h > 1) {
+    w = w > 1 ? w / 2 : 1;
+    h = h > 1 ? h / 2 : 1;
+    total += (size_t) w * h;
+  }
+  return total;
+}
+
+// points every level into one block, level 0 is either copied into it or borrowed from the caller
+void layoutMipChain(MyGL_MipChain &chain, MyGL_ROImage image, bool borrow) {
+  bool reuse = chain.arena && chain.levels[0].w == image.w && chain.levels[0].h == image.h && chain.borrowed == borrow;
+  if (!reuse) {
+    MyGL_mipChainFree(&chain);
+    chain.arenaSize = mipChainPixels(image.w, image.h, !borrow);
+    chain.arena = new MyGL_Color[chain.arenaSize];
+    chain.borrowed = borrow;
   }
 
-  if (1 == image.h) {
-    out = MyGL_imageAlloc(image.w / 2, 1);
+  MyGL_Color *next = chain.arena;
+  chain.count = 0;
+  if (borrow) {
+    chain.levels[chain.count++] = MyGL_Image { .w = image.w, .h = image.h, .pixels = (MyGL_Color*) image.pixels };
+  } else {
+    memcpy((void*) next, image.pixels, (size_t) image.w * image.h * sizeof(MyGL_Color));
+    chain.levels[chain.count++] = MyGL_Image { .w = image.w, .h = image.h, .pixels = next };
+    next += (size_t) image.w * image.h;
+  }
+  while (chain.levels[chain.count - 1].w > 1 || chain.levels[chain.count - 1].h > 1) {
+    const MyGL_Image &prev = chain.levels[chain.count - 1];
+    MyGL_Image level = { .w = prev.w > 1 ? prev.w / 2 : 1, .h = prev.h > 1 ? prev.h / 2 : 1, .pixels = next };
+    next += (size_t) level.w * level.h;
+    chain.levels[chain.count++] = level;
+  }
+}
 
-    bool oddw = (image.w & 0x01) > 0;
-    for (uint32_t x = 0; x < out.w; x++) {
-      bool endx = x == (out.w - 1);
-      auto w = oddw && endx ? 3 : 2;
-      out.pixels[x] = MyGL_imageSampleBox(image, x * 2, 0, w, 1);
+void buildMipsSerial(MyGL_MipChain &chain) {
+  for (size_t l = 1; l < chain.count; l++)
+    mipRows(MyGL_roImage(chain.levels[l - 1]), chain.levels[l - 1].w, chain.levels[l], 0, chain.levels[l].h);
+}
+
+void buildMipsParallel(MyGL_MipChain &chain, uint32_t threads) {
+  // each level is split into row bands, a band is queued once every band of the level above it reads from is done
+  struct Band {
+    uint32_t y0 = 0, y1 = 0;
+    uint32_t firstDependent = UINT32_MAX, lastDependent = 0;
+    std::atomic<uint32_t> pending { 0 };
+  };
+  const uint32_t bandPixels = 64 * 1024;
+
+  std::vector<std::vector<Band> > bands;
+  std::vector<uint32_t> bandRows;
+  bands.reserve(chain.count);
+  bands.emplace_back();  // level 0 is the source
+  bandRows.push_back(chain.levels[0].h);
+  for (size_t l = 1; l < chain.count; l++) {
+    const MyGL_Image &level = chain.levels[l];
+    const MyGL_Image &src = chain.levels[l - 1];
+    uint32_t rows = bandPixels / level.w;
+    rows = rows ? rows : 1;
+    bandRows.push_back(rows);
+    bands.emplace_back((level.h + rows - 1) / rows);
+    for (size_t b = 0; b < bands[l].size(); b++) {
+      Band &band = bands[l][b];
+      band.y0 = (uint32_t) b * rows;
+      band.y1 = std::min(band.y0 + rows, level.h);
+      if (1 == l)
+        continue;
+      uint32_t srcY0 = src.h > 1 ? band.y0 * 2 : 0;
+      uint32_t srcY1 = src.h > 1 ? band.y1 * 2 + ((band.y1 == level.h && (src.h & 0x01)) ? 1 : 0) : 1;
+      uint32_t first = srcY0 / bandRows[l - 1];
+      uint32_t last = (srcY1 - 1) / bandRows[l - 1];
+      band.pending = last - first + 1;
+      for (uint32_t d = first; d <= last; d++) {
+        bands[l - 1][d].firstDependent = std::min(bands[l - 1][d].firstDependent, (uint32_t) b);
+        bands[l - 1][d].lastDependent = std::max(bands[l - 1][d].lastDependent, (uint32_t) b);
+      }
     }
-    return out;
   }
 
-  out = MyGL_imageAlloc(image.w / 2, image.h / 2);
+  utils::TaskGroup tasks(utils::sharedPool(), threads);
+  std::function<void(size_t, size_t)> run = [&](size_t l, size_t b) {
+    Band &band = bands[l][b];
+    const MyGL_Image &src = chain.levels[l - 1];
+    mipRows(MyGL_roImage(src), src.w, chain.levels[l], band.y0, band.y1);
+    if (l + 1 == chain.count || band.firstDependent == UINT32_MAX)
+      return;
+    for (uint32_t d = band.firstDependent; d <= band.lastDependent; d++)
+      if (1 == bands[l + 1][d].pending.fetch_sub(1))
+        tasks.enqueue([&run, l, d]() {
+          run(l + 1, d);
+        });
+  };
+  for (size_t b = 0; b < bands[1].size(); b++)
+    tasks.enqueue([&run, b]() {
+      run(1, b);
+    });
+  tasks.wait();
+}
 
-  bool oddw = (image.w & 0x01) > 0;
-  bool oddh = (image.h & 0x01) > 0;
-  for (uint32_t y = 0; y < out.h; y++)
-    for (uint32_t x = 0; x < out.w; x++) {
-      bool endx = x == (out.w - 1);
-      bool endy = y == (out.h - 1);
-      auto w = oddw && endx ? 3 : 2;
-      auto h = oddh && endy ? 3 : 2;
-      out.pixels[y * out.w + x] = MyGL_imageSampleBox(image, x * 2, y * 2, w, h);
-    }
+void buildMips(MyGL_MipChain &chain, const MyGL_MipOptions &options) {
+  if (MYGL_FILTER_BOX != options.filter || options.srgb) {
+    for (size_t l = 1; l < chain.count; l++)
+      resample::resize(MyGL_roImage(chain.levels[l - 1]), chain.levels[l], options.filter, options.srgb, options.threads);
+    return;
+  }
+  // not worth waking up workers for small images
+  size_t pixels = (size_t) chain.levels[0].w * chain.levels[0].h;
+  if (1 == options.threads || pixels < 512 * 512)
+    buildMipsSerial(chain);
+  else
+    buildMipsParallel(chain, options.threads);
+}
+
+}
 
-  return out;
 }
 
 MyGL_MipChain MyGL_mipChainCreate(MyGL_ROImage image) {
+  MyGL_MipOptions options = { .filter = MYGL_FILTER_BOX, .srgb = 0, .threads = 1, .borrowLevel0 = 0 };
+  return MyGL_mipChainCreateFiltered(image, &options);
+}
+
+MyGL_MipChain MyGL_mipChainCreateParallel(MyGL_ROImage image, uint32_t threads) {
+  MyGL_MipOptions options = { .filter = MYGL_FILTER_BOX, .srgb = 0, .threads = threads, .borrowLevel0 = 0 };
+  return MyGL_mipChainCreateFiltered(image, &options);
+}
+
+MyGL_MipChain MyGL_mipChainCreateFiltered(MyGL_ROImage image, const MyGL_MipOptions *options) {
   MyGL_MipChain chain;
-  chain.count = 0;
   memset((void*) &chain, 0, sizeof(MyGL_MipChain));
-  if (!image.pixels)
-    return chain;
+  MyGL_mipChainUpdate(&chain, image, options);
+  return chain;
+}
 
-  chain.levels[chain.count++] = MyGL_imageDup(image);
-  while (true) {
-    chain.levels[chain.count] = MyGL_imageMip(MyGL_roImage(chain.levels[chain.count - 1]));
-    if (!chain.levels[chain.count].pixels)
-      break;
-    chain.count++;
+void MyGL_mipChainUpdate(MyGL_MipChain *chain, MyGL_ROImage image, const MyGL_MipOptions *options) {
+  if (!image.pixels || !image.w || !image.h) {
+    MyGL_mipChainFree(chain);
+    return;
   }
-  return chain;
+  MyGL_MipOptions defaults = { .filter = MYGL_FILTER_BOX, .srgb = 0, .threads = 0, .borrowLevel0 = 0 };
+  if (!options)
+    options = &defaults;
+  mygl::layoutMipChain(*chain, image, options->borrowLevel0);
+  mygl::buildMips(*chain, *options);
 }
 
 void MyGL_mipChainFree(MyGL_MipChain *chain) {
-  for (size_t i = 0; i < chain->count; i++)
-    MyGL_imageFree(&chain->levels[i]);
+  if (chain->arena) {
+    delete[] chain->arena;
+  } else {
+    for (size_t i = 0; i < chain->count; i++)
+      MyGL_imageFree(&chain->levels[i]);
+  }
   memset((void*) chain, 0, sizeof(MyGL_MipChain));
 }
 
 MyGL_Image MyGL_imageFromBMPData(const void *data, uint32_t size, const char *source) {
   MyGL_Image image = { .w = 0, .h = 0, .pixels = nullptr };
   if (data && size) {
-    const uint8_t *begin = (const uint8_t*) data;
-    const uint8_t *end = &begin[size];
-    std::vector<uint8_t> rawData(begin, end);
-    image = utils::bmp::imageFromBitmapData(rawData, source);
+    image = utils::bmp::imageFromBitmapData(data, size, source);
     if (MyGL_Debug_getChatty())
       utils::logout("%s - image '%s' (%d x %d)", __func__, source, image.w, image.h);
   }
   return image;
 }
 
+// lodepng hands its zlib streams to miniz, whose inflater is a good deal faster than its own
+// context: the inflated size when the header gives it away, so the scanlines are allocated once
+static unsigned inflateMiniz(unsigned char **out, size_t *outsize, const unsigned char *in, size_t insize, const LodePNGDecompressSettings *settings) {
+  size_t expected = settings->custom_context ? *(const size_t*) settings->custom_context : 0;
+  if (expected) {
+    unsigned char *buffer = (unsigned char*) malloc(expected);
+    if (buffer && tinfl_decompress_mem_to_mem(buffer, expected, in, insize, TINFL_FLAG_PARSE_ZLIB_HEADER) == expected) {
+      *out = buffer;
+      *outsize = expected;
+      return 0;
+    }
+    free(buffer);
+  }
+  size_t n = 0;
+  void *buffer = tinfl_decompress_mem_to_heap(in, insize, &n, TINFL_FLAG_PARSE_ZLIB_HEADER);
+  if (!buffer)
+    return 1;
+  *out = (unsigned char*) buffer;
+  *outsize = n;
+  return 0;
+}
+
+// lodepng_decode_memory with the miniz inflater plugged in
+static unsigned decodePNG(uint8_t **out, uint32_t *w, uint32_t *h, const void *data, uint32_t size, LodePNGColorType colortype, unsigned bitdepth) {
+  LodePNGState state;
+  lodepng_state_init(&state);
+  state.info_raw.colortype = colortype;
+  state.info_raw.bitdepth = bitdepth;
+#ifdef LODEPNG_COMPILE_ANCILLARY_CHUNKS
+  state.decoder.read_text_chunks = 0;
+  state.decoder.remember_unknown_chunks = 0;
+#endif
+  // filter byte + packed row, adam7 passes are left to the growing path
+  size_t expected = 0;
+  if (!lodepng_inspect(w, h, &state, (const uint8_t*) data, size) && !state.info_png.interlace_method)
+    expected = (size_t) *h * (1 + ((size_t) *w * lodepng_get_bpp(&state.info_png.color) + 7) / 8);
+  state.decoder.zlibsettings.custom_zlib = inflateMiniz;
+  state.decoder.zlibsettings.custom_context = &expected;
+  unsigned rc = lodepng_decode(out, w, h, &state, (const uint8_t*) data, size);
+  lodepng_state_cleanup(&state);
+  return rc;
+}
+
+static unsigned decodePNG32(uint8_t **out, uint32_t *w, uint32_t *h, const void *data, uint32_t size) {
+  return decodePNG(out, w, h, data, size, LCT_RGBA, 8);
+}
+
+int MyGL_imagePNGInfo(const void *data, uint32_t size, uint32_t *w, uint32_t *h) {
+  if (!data || !size || !w || !h)
+    return 0;
+  LodePNGState state;
+  lodepng_state_init(&state);
+  unsigned rc = lodepng_inspect(w, h, &state, (const uint8_t*) data, size);
+  lodepng_state_cleanup(&state);
+  return rc ? 0 : 1;
+}
+
+int MyGL_imageDecodePNGInto(const void *data, uint32_t size, const char *source, MyGL_Image dest) {
+  if (!data || !size || !dest.pixels)
+    return 0;
+
+  uint8_t *buffer;
+  uint32_t w, h;
+  unsigned rc = decodePNG32(&buffer, &w, &h, data, size);
+  if (rc) {
+    const char *error = lodepng_error_text(rc);
+    utils::logout("error: '%s' PNG decoding failed, reason '%s'", source, error);
+    return 0;
+  }
+  if (w != dest.w || h != dest.h) {
+    utils::logout("error: '%s' PNG is %u x %u, destination is %u x %u", source, w, h, dest.w, dest.h);
+    free(buffer);
+    return 0;
+  }
+
+  // flip and rgba -> bgra in the same pass
+  const uint32_t *in = (const uint32_t*) buffer;
+  uint32_t *out = (uint32_t*) dest.pixels;
+  for (size_t y = 0; y < h; y++)
+    utils::pixels::swizzleRow(&out[(h - 1 - y) * w], &in[y * w], w);
+  free(buffer);
+  return 1;
+}
+
 MyGL_Image MyGL_imageFromPNGData(const void *data, uint32_t size, const char *source) {
   MyGL_Image image = { .w = 0, .h = 0, .pixels = nullptr };
 
   if (data && size) {
-    uint8_t *buffer;
-    int rc = lodepng_decode32(&buffer, &image.w, &image.h, (const uint8_t*) data, size);
-    if (rc) {
-      const char *error = lodepng_error_text(rc);
-      utils::logout("error: '%s' PNG decoding failed, reason '%s'", source, error);
+    uint32_t w, h;
+    if (!MyGL_imagePNGInfo(data, size, &w, &h)) {
+      utils::logout("error: '%s' is not a valid PNG image", source);
       return image;
     }
-    image.pixels = (MyGL_Color*) buffer;
-
-    // flip
-    for (size_t y = 0; y < image.h / 2; y++) {
-      size_t topRowStart = y * image.w;
-      size_t bottomRowStart = (image.h - 1 - y) * image.w;
-      for (size_t x = 0; x < image.w; x++)
-        swap<MyGL_Color>(image.pixels[topRowStart + x], image.pixels[bottomRowStart + x]);
+    image = MyGL_imageAlloc(w, h);
+    if (!MyGL_imageDecodePNGInto(data, size, source, image)) {
+      MyGL_imageFree(&image);
+      return image;
     }
 
-    // rgba -> bgra
-    for (size_t i = 0; i < image.w * image.h; i++)
-      swap<uint8_t>(image.pixels[i].rgba[0], image.pixels[i].rgba[2]);
-
     if (MyGL_Debug_getChatty())
       utils::logout("%s - image '%s' (%d x %d)", __func__, source, image.w, image.h);
   }
   return image;
 }
+
+uint32_t MyGL_imagesFromPNGDataBatch(const void *const *data, const uint32_t *sizes, const char *const *sources, uint32_t count, MyGL_Image *images, uint32_t threads) {
+  if (!data || !sizes || !images)
+    return 0;
+
+  std::atomic<uint32_t> decoded { 0 };
+  auto decode = [&](uint32_t i) {
+    images[i] = MyGL_imageFromPNGData(data[i], sizes[i], sources ? sources[i] : "");
+    if (images[i].pixels)
+      decoded++;
+  };
+  if (threads == 1 || count < 2) {
+    for (uint32_t i = 0; i < count; i++)
+      decode(i);
+    return decoded;
+  }
+
+  // one job per file, the pool balances big and small ones
+  utils::TaskGroup tasks(utils::sharedPool(), threads);
+  for (uint32_t i = 0; i < count; i++)
+    tasks.enqueue([&decode, i]() {
+      decode(i);
+    });
+  tasks.wait();
+  return decoded;
+}
+
+uint32_t MyGL_pixelTypeSize(MyGL_PixelType type) {
+  switch (type) {
+    case MYGL_PIXEL_R8:
+      return 1;
+    case MYGL_PIXEL_RG8:
+    case MYGL_PIXEL_R16F:
+      return 2;
+    case MYGL_PIXEL_RGBA16F:
+      return 8;
+  }
+  return 0;
+}
+
+void MyGL_typedImageFree(MyGL_TypedImage *image) {
+  image->w = image->h = 0;
+  if (image->pixels) {
+    delete[] (uint8_t*) image->pixels;
+    image->pixels = nullptr;
+  }
+}
+
+MyGL_TypedImage MyGL_typedImageAlloc(uint32_t w, uint32_t h, MyGL_PixelType type) {
+  MyGL_TypedImage image;
+  image.w = w > 1 ? w : 1;
+  image.h = h > 1 ? h : 1;
+  image.type = type;
+  image.pixels = new uint8_t[(size_t) image.w * image.h * MyGL_pixelTypeSize(type)];
+  return image;
+}
+
+namespace {
+
+uint32_t channelCount(MyGL_PixelType type) {
+  return type == MYGL_PIXEL_RG8 ? 2 : type == MYGL_PIXEL_RGBA16F ? 4 : 1;
+}
+
+bool isHalf(MyGL_PixelType type) {
+  return type == MYGL_PIXEL_R16F || type == MYGL_PIXEL_RGBA16F;
+}
+
+// packs n texels of up to 4 channels, src channels are scaled by 1 / range for the half types
+template<typename T>
+void packTexels(void *dst, MyGL_PixelType type, const T *src, size_t srcStride, size_t n, float range) {
+  uint32_t channels = channelCount(type);
+  if (isHalf(type)) {
+    uint16_t *out = (uint16_t*) dst;
+    float scale = 1.0f / range;
+    for (size_t i = 0; i < n; i++, src += srcStride)
+      for (uint32_t c = 0; c < channels; c++)
+        *out++ = utils::pixels::floatToHalf((float) src[c] * scale);
+  } else {
+    uint8_t *out = (uint8_t*) dst;
+    for (size_t i = 0; i < n; i++, src += srcStride)
+      for (uint32_t c = 0; c < channels; c++)
+        *out++ = (uint8_t) src[c];
+  }
+}
+
+}
+
+MyGL_TypedImage MyGL_typedImageFromImage(MyGL_ROImage image, MyGL_PixelType type) {
+  MyGL_TypedImage out = { .w = 0, .h = 0, .type = type, .pixels = nullptr };
+  if (!image.w || !image.h || !image.pixels)
+    return out;
+
+  out = MyGL_typedImageAlloc(image.w, image.h, type);
+  size_t n = (size_t) image.w * image.h, texel = MyGL_pixelTypeSize(type);
+  uint8_t *dst = (uint8_t*) out.pixels;
+  // BGRA in memory, reorder to red first
+  for (size_t i = 0; i < n; i++, dst += texel) {
+    const uint8_t *c = image.pixels[i].rgba;
+    const uint8_t rgba[4] = { c[2], c[1], c[0], c[3] };
+    packTexels(dst, type, rgba, 4, 1, 255.0f);
+  }
+  return out;
+}
+
+MyGL_TypedImage MyGL_typedImageFromPNGData(const void *data, uint32_t size, const char *source, MyGL_PixelType type) {
+  MyGL_TypedImage image = { .w = 0, .h = 0, .type = type, .pixels = nullptr };
+  if (!data || !size)
+    return image;
+
+  // lodepng only narrows color to 8 bit grey, the other types pick their channels out of RGBA
+  bool wide = isHalf(type);
+  LodePNGColorType decodeAs = type == MYGL_PIXEL_R8 ? LCT_GREY : LCT_RGBA;
+  uint8_t *buffer;
+  uint32_t w, h;
+  unsigned rc = decodePNG(&buffer, &w, &h, data, size, decodeAs, wide ? 16 : 8);
+  if (rc) {
+    const char *error = lodepng_error_text(rc);
+    utils::logout("error: '%s' PNG decoding failed, reason '%s'", source, error);
+    return image;
+  }
+
+  image = MyGL_typedImageAlloc(w, h, type);
+  size_t stride = decodeAs == LCT_GREY ? 1 : 4, pitch = (size_t) w * MyGL_pixelTypeSize(type);
+  std::vector<uint16_t> row(wide ? (size_t) w * 4 : 0);
+  for (size_t y = 0; y < h; y++) {
+    uint8_t *dst = (uint8_t*) image.pixels + (h - 1 - y) * pitch;
+    if (wide) {
+      // 16 bit samples are big-endian
+      const uint8_t *in = &buffer[y * w * 8];
+      for (size_t i = 0; i < row.size(); i++)
+        row[i] = (uint16_t) (in[i * 2] << 8 | in[i * 2 + 1]);
+      packTexels(dst, type, row.data(), 4, w, 65535.0f);
+    } else {
+      packTexels(dst, type, &buffer[y * w * stride], stride, w, 255.0f);
+    }
+  }
+  free(buffer);
+
+  if (MyGL_Debug_getChatty())
+    utils::logout("%s - image '%s' (%d x %d)", __func__, source, image.w, image.h);
+  return image;
+}
+
+MyGL_TypedImage MyGL_typedImageMip(MyGL_TypedImage image) {
+  MyGL_TypedImage out = { .w = 0, .h = 0, .type = image.type, .pixels = nullptr };
+  if (!image.w || !image.h || !image.pixels || (image.w == 1 && image.h == 1))
+    return out;
+
+  out = MyGL_typedImageAlloc(image.w / 2, image.h / 2, image.type);
+  uint32_t channels = channelCount(image.type);
+  bool half = isHalf(image.type);
+  // same footprints as mipRows: 2x2, or 3 wide / tall on the last texel of an odd edge
+  uint32_t sx = image.w > 1 ? 2 : 1, sy = image.h > 1 ? 2 : 1;
+  bool oddw = sx == 2 && (image.w & 1), oddh = sy == 2 && (image.h & 1);
+  for (uint32_t y = 0; y < out.h; y++) {
+    uint32_t rows = oddh && y == out.h - 1 ? 3 : sy;
+    for (uint32_t x = 0; x < out.w; x++) {
+      uint32_t cols = oddw && x == out.w - 1 ? 3 : sx;
+      float sum[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+      for (uint32_t j = 0; j < rows; j++)
+        for (uint32_t i = 0; i < cols; i++) {
+          size_t index = ((size_t) (y * sy + j) * image.w + x * sx + i) * channels;
+          for (uint32_t c = 0; c < channels; c++)
+            sum[c] += half ? utils::pixels::halfToFloat(((const uint16_t*) image.pixels)[index + c]) : ((const uint8_t*) image.pixels)[index + c];
+        }
+      size_t index = ((size_t) y * out.w + x) * channels;
+      float scale = 1.0f / (float) (rows * cols);
+      for (uint32_t c = 0; c < channels; c++) {
+        // the 8 bit types truncate like reduceBox
+        if (half)
+          ((uint16_t*) out.pixels)[index + c] = utils::pixels::floatToHalf(sum[c] * scale);
+        else
+          ((uint8_t*) out.pixels)[index + c] = (uint8_t) ((uint32_t) sum[c] / (rows * cols));
+      }
+    }
+  }
+  return out;
+}
@@ -1,34 +1,37 @@
+#pragma once
+
 #include "public/image.h"
 
 #include <vector>
 
 namespace mygl {
 
+// writes rows [y0, y1) of the 2:1 reduction of src into dst, src rows are srcPitch pixels apart
+void mipRows(MyGL_ROImage src, uint32_t srcPitch, MyGL_Image dst, uint32_t y0, uint32_t y1);
+
 inline MyGL_ROImage toRo(const MyGL_Image &image) {
   return MyGL_ROImage { .w = image.w, .h = image.h, .pixels = image.pixels };
 }
 
 struct Mipmaps {
+  MyGL_MipChain chain = { };
   size_t count = 0;
-  MyGL_Image stack[32];
 
-  void generate(MyGL_ROImage from) {
+  void generate(MyGL_ROImage from, bool borrow = false) {
     if (!from.pixels) {
       return;
     }
-    stack[count++] = MyGL_imageDup(from);
-    while (true) {
-      stack[count] = MyGL_imageMip(toRo(stack[count - 1]));
-      if (!stack[count].pixels)
-        break;
-      count++;
-    }
+    MyGL_MipOptions options = { .filter = MYGL_FILTER_BOX, .srgb = 0, .threads = 1, .borrowLevel0 = borrow };
+    MyGL_mipChainUpdate(&chain, from, &options);
+    count = chain.count;
+  }
+
+  const MyGL_Image& operator[](size_t level) const {
+    return chain.levels[level];
   }
 
   void free() {
-    for (size_t i = 0; i < count; i++) {
-      MyGL_imageFree(&stack[i]);
-    }
+    MyGL_mipChainFree(&chain);
     count = 0;
   }
 
@@ -1,12 +1,20 @@
 #include "utils/log.h"
 #include "utils/str.h"
 #include "utils/stateful.h"
+#include "utils/hash.h"
 #include "utils/thirdparty/miniz/miniz.h"
 
 #include "colors.h"
 #include "streams.h"
 #include "textures.h"
+#include "texcache.h"
+#include "texcontainer.h"
+#include "streaming.h"
+#include "residency.h"
+#include "vtexture.h"
+#include "capture.h"
 #include "framebuffer.h"
+#include "model.h"
 #include "mygl.h"
 #include "shaders.h"
 #include "public/vecdefs.h"
@@ -98,6 +106,8 @@ MyGL* MyGL_initialize(MyGL_LogFunc logger, int initialize_glew, uint32_t stream_
   shaders::globalUniformSetters.emplace("mygl.matProj", &myGL.P_matrix);
   shaders::globalUniformSetters.emplace("mygl.matView", &myGL.V_matrix);
   shaders::globalUniformSetters.emplace("mygl.matWorld", &myGL.W_matrix);
+  shaders::globalUniformSetters.emplace("mygl.meshOffset", &modelMeshOffset);
+  shaders::globalUniformSetters.emplace("mygl.meshScale", &modelMeshScale);
 
   shaders::globalUniformSetters.emplace("mygl.matProjViewWorld", [&]() -> MyGL_Mat4 {
     MyGL_Mat4 m = MyGL_mat4Multiply(myGL.V_matrix, myGL.W_matrix);
@@ -105,6 +115,9 @@ MyGL* MyGL_initialize(MyGL_LogFunc logger, int initialize_glew, uint32_t stream_
     return m;
   });
 
+  MyGL_loadShaderLibraryStr(virtualTextureLibrary, "virtualtexture.glsl");
+  MyGL_loadShaderLibraryStr(quantizedVertexLibrary, "quantized.glsl");
+
   for (auto& [k, v] : shaders::globalUniformSetters) {
     utils::logout(" * global uniform: '%s'", k.c_str());
   }
@@ -252,6 +265,7 @@ void MyGL_bindSamplers() {
       {
         auto f = named2DTextures.find(myGL.samplers[i].chars);
         if (f != named2DTextures.end()) {
+          residency::touch(f->second.get());
           f->second->apply(i);
 //utils::logout( "%s - binding '%s' to %d", __FUNCTION__, f->first.c_str(), (int)i );
         }
@@ -281,6 +295,7 @@ void MyGL_bindSampler(uint32_t index) {
     {
       auto f = named2DTextures.find(myGL.samplers[index].chars);
       if (f != named2DTextures.end()) {
+        residency::touch(f->second.get());
         f->second->apply(index);
 //utils::logout( "%s - binding '%s' to %d", __FUNCTION__, f->first.c_str(), (int)i );
       }
@@ -377,26 +392,201 @@ GLboolean MyGL_loadShaderStr(const char *source_str, const char *alias) {
   return GL_TRUE;
 }
 
+// evicted textures that have a cooked file come back by mapping it again
+static residency::Reload reloadFromCache(const std::string &path, const std::string &format, const MyGL_TextureOptions &options) {
+  return [=](const std::shared_ptr<Texture2D> &tex) {
+    texcache::Cooked cooked;
+    if (!texcache::load(path, tex->format, cooked)) {
+      utils::logout("%s error: cannot reload texture '%s' from '%s'", __func__, tex->name.c_str(), path.c_str());
+      return;
+    }
+    Texture2D fresh(tex->name.c_str(), cooked.levels, format.c_str(), options);
+    tex->adopt(fresh.tex, fresh.sizes[0], fresh.sizes[1], fresh.numMips);
+    fresh.tex = 0;
+  };
+}
+
 GLboolean MyGL_createTexture2D(const char *name, MyGL_ROImage image, const char *format, GLboolean filtered, GLboolean mipmapped, GLboolean repeat) {
+  MyGL_TextureOptions options = { .filtered = filtered, .mipmapped = mipmapped, .repeat = repeat, .mipOptions = { }, .cacheKey = 0, .progressive = GL_FALSE, .immutable = GL_FALSE, .gpuMipmaps = GL_FALSE };
+  return MyGL_createTexture2DEx(name, image, format, &options);
+}
+
+GLboolean MyGL_createTexture2DEx(const char *name, MyGL_ROImage image, const char *format, const MyGL_TextureOptions *options) {
   if (!name) {
     utils::logout("%s error: texture has no alias", __func__);
     return GL_FALSE;
   }
 
-  if (!image.w || !image.h || !image.pixels) {
+  if (!options) {
+    utils::logout("%s error: texture '%s' has no options", __func__, name);
+    return GL_FALSE;
+  }
+
+  if (!image.w || !image.h || (!image.pixels && !options->immutable)) {
     utils::logout("%s error: texture image '%s' is invalid", __func__, name);
     return GL_FALSE;
   }
 
-  auto tex = std::make_shared<Texture2D>(name, image, format, filtered, mipmapped, repeat);
+  auto tex = std::make_shared<Texture2D>(name, image, format, *options);
   named2DTextures[name] = tex;
   if (MyGL_Debug_getChatty()) {
     utils::logout("%s 2D texture '%s' created:", __func__, name);
     tex->logInfo();
   }
+  residency::Reload reload = nullptr;
+  if (options->cacheKey) {
+    std::string path = texcache::pathFor(options->cacheKey, tex->format, *options);
+    if (path.empty())
+      utils::logout("%s warning: texture '%s' has a cache key but no cache directory is set", __func__, name);
+    else if (texcache::store(path, tex->tex, tex->format, tex->numMips))
+      reload = reloadFromCache(path, format, *options);
+  }
+  residency::track(tex, reload);
   return GL_TRUE;
 }
 
+GLboolean MyGL_createTexture2DTyped(const char *name, MyGL_TypedImage image, const char *format, const MyGL_TextureOptions *options) {
+  if (!name) {
+    utils::logout("%s error: texture has no alias", __func__);
+    return GL_FALSE;
+  }
+
+  if (!options) {
+    utils::logout("%s error: texture '%s' has no options", __func__, name);
+    return GL_FALSE;
+  }
+
+  if (!image.w || !image.h || !image.pixels || image.type > MYGL_PIXEL_RGBA16F) {
+    utils::logout("%s error: texture image '%s' is invalid", __func__, name);
+    return GL_FALSE;
+  }
+
+  // the block encoder works on 32 bit pixels
+  if (colorFormatByName(format).blockBytes) {
+    utils::logout("%s error: texture '%s' cannot be compressed from a typed image", __func__, name);
+    return GL_FALSE;
+  }
+
+  auto tex = std::make_shared<Texture2D>(name, image, format, *options);
+  named2DTextures[name] = tex;
+  if (MyGL_Debug_getChatty()) {
+    utils::logout("%s 2D texture '%s' created:", __func__, name);
+    tex->logInfo();
+  }
+  residency::track(tex, nullptr);
+  return GL_TRUE;
+}
+
+void MyGL_setTextureCacheDir(const char *dir) {
+  texcache::setDir(dir);
+}
+
+uint64_t MyGL_textureCacheKey(const void *data, uint32_t size) {
+  return data ? utils::hash64(data, size) : 0;
+}
+
+GLboolean MyGL_createTexture2DFromCache(const char *name, uint64_t key, const char *format, const MyGL_TextureOptions *options) {
+  if (!name) {
+    utils::logout("%s error: texture has no alias", __func__);
+    return GL_FALSE;
+  }
+
+  if (!options) {
+    utils::logout("%s error: texture '%s' has no options", __func__, name);
+    return GL_FALSE;
+  }
+
+  texcache::Cooked cooked;
+  std::string path = texcache::pathFor(key, colorFormatByName(format), *options);
+  if (!texcache::load(path, colorFormatByName(format), cooked))
+    return GL_FALSE;
+
+  auto tex = std::make_shared<Texture2D>(name, cooked.levels, format, *options);
+  named2DTextures[name] = tex;
+  if (MyGL_Debug_getChatty()) {
+    utils::logout("%s 2D texture '%s' loaded from cache:", __func__, name);
+    tex->logInfo();
+  }
+  residency::track(tex, reloadFromCache(path, format, *options));
+  return GL_TRUE;
+}
+
+// one layer makes a 2D texture, more make an array; the mip count comes from the file
+static GLboolean createFromContainer(const char *func, const char *name, const texcontainer::Parsed &parsed, MyGL_TextureOptions options, residency::Reload reload) {
+  options.mipmapped = parsed.layers[0].size() > 1;
+  options.immutable = GL_FALSE;
+  // r8/rg8 rows are tightly packed
+  glPixelStorei( GL_UNPACK_ALIGNMENT, 1);
+  if (parsed.layers.size() == 1) {
+    auto tex = std::make_shared<Texture2D>(name, parsed.layers[0], parsed.format.c_str(), options, parsed.pixelFormat);
+    named2DTextures[name] = tex;
+    residency::track(tex, reload);
+  } else {
+    named3DTextures[name] = std::make_shared<Texture2DArray>(name, parsed.layers, parsed.format.c_str(), options, parsed.pixelFormat);
+  }
+  glPixelStorei( GL_UNPACK_ALIGNMENT, 4);
+  if (MyGL_Debug_getChatty())
+    utils::logout("%s texture '%s' created (%s, %zu layer(s), %zu level(s))", func, name, parsed.format.c_str(), parsed.layers.size(), parsed.layers[0].size());
+  return GL_TRUE;
+}
+
+GLboolean MyGL_createTextureFromContainer(const char *name, const void *data, uint32_t size, const MyGL_TextureOptions *options) {
+  if (!name) {
+    utils::logout("%s error: texture has no alias", __func__);
+    return GL_FALSE;
+  }
+
+  if (!options) {
+    utils::logout("%s error: texture '%s' has no options", __func__, name);
+    return GL_FALSE;
+  }
+
+  texcontainer::Parsed parsed;
+  if (!texcontainer::parse((const uint8_t*) data, size, name, parsed))
+    return GL_FALSE;
+  return createFromContainer(__func__, name, parsed, *options, nullptr);
+}
+
+GLboolean MyGL_createTextureFromContainerFile(const char *name, const char *path, const MyGL_TextureOptions *options) {
+  if (!name || !path) {
+    utils::logout("%s error: texture has no alias or file", __func__);
+    return GL_FALSE;
+  }
+
+  if (!options) {
+    utils::logout("%s error: texture '%s' has no options", __func__, name);
+    return GL_FALSE;
+  }
+
+  utils::MappedFile file;
+  if (!file.open(path)) {
+    utils::logout("%s error: cannot open '%s'", __func__, path);
+    return GL_FALSE;
+  }
+  texcontainer::Parsed parsed;
+  if (!texcontainer::parse(file.data(), file.size(), path, parsed))
+    return GL_FALSE;
+
+  // evicted 2D textures come back by mapping the file again
+  std::string filePath = path;
+  MyGL_TextureOptions reloaded = *options;
+  return createFromContainer(__func__, name, parsed, *options, [filePath, reloaded](const std::shared_ptr<Texture2D> &tex) {
+    utils::MappedFile file;
+    texcontainer::Parsed parsed;
+    if (!file.open(filePath.c_str()) || !texcontainer::parse(file.data(), file.size(), filePath.c_str(), parsed) || parsed.layers.size() != 1) {
+      utils::logout("%s error: cannot reload texture '%s' from '%s'", __func__, tex->name.c_str(), filePath.c_str());
+      return;
+    }
+    MyGL_TextureOptions options = reloaded;
+    options.mipmapped = parsed.layers[0].size() > 1;
+    glPixelStorei( GL_UNPACK_ALIGNMENT, 1);
+    Texture2D fresh(tex->name.c_str(), parsed.layers[0], parsed.format.c_str(), options, parsed.pixelFormat);
+    glPixelStorei( GL_UNPACK_ALIGNMENT, 4);
+    tex->adopt(fresh.tex, fresh.sizes[0], fresh.sizes[1], fresh.numMips);
+    fresh.tex = 0;
+  });
+}
+
 DLLEXPORT GLboolean MyGL_uploadTexture2D(const char *name, MyGL_WriteFormat format, MyGL_ReadWriteType type, uint32_t w, uint32_t h, void *pixels) {
   if (!name) {
     utils::logout("%s error: no texture specified", __func__);
@@ -414,6 +604,157 @@ DLLEXPORT GLboolean MyGL_uploadTexture2D(const char *name, MyGL_WriteFormat form
   return true;
 }
 
+GLboolean MyGL_streamTexture2D(const char *name, const void *data, uint32_t size, const char *format, const MyGL_TextureOptions *options) {
+  if (!name) {
+    utils::logout("%s error: texture has no alias", __func__);
+    return GL_FALSE;
+  }
+
+  if (!data || !size) {
+    utils::logout("%s error: texture '%s' has no data", __func__, name);
+    return GL_FALSE;
+  }
+
+  if (!options) {
+    utils::logout("%s error: texture '%s' has no options", __func__, name);
+    return GL_FALSE;
+  }
+
+  // usable right away, the pump swaps the real storage in once it is uploaded
+  MyGL_Color grey;
+  grey.value = 0xff808080;
+  MyGL_ROImage image = { 1, 1, &grey };
+  MyGL_TextureOptions placeholder = *options;
+  placeholder.mipmapped = GL_FALSE;
+  placeholder.cacheKey = 0;
+  auto tex = std::make_shared<Texture2D>(name, image, format, placeholder);
+  tex->resident = false;
+  named2DTextures[name] = tex;
+
+  // the encoded file is kept so an evicted texture can simply be streamed in again
+  auto encoded = std::make_shared<const std::vector<uint8_t> >((const uint8_t*) data, (const uint8_t*) data + size);
+  MyGL_TextureOptions streamed = *options;
+  streaming::enqueue(name, encoded, streamed, tex);
+  residency::track(tex, [encoded, streamed](const std::shared_ptr<Texture2D> &tex) {
+    streaming::enqueue(tex->name.c_str(), encoded, streamed, tex);
+  });
+  return GL_TRUE;
+}
+
+void MyGL_setTextureStreamBudget(uint32_t bytes_per_frame) {
+  streaming::setBudget(bytes_per_frame);
+}
+
+uint32_t MyGL_pumpTextureStreams() {
+  return streaming::pump();
+}
+
+void MyGL_requestTextureLevel(const char *name, uint32_t level) {
+  auto find = named2DTextures.find(name ? name : "");
+  if (find == named2DTextures.end())
+    return;
+  streaming::demandLevel(dynamic_cast<Texture2D*>(find->second.get()), level);
+}
+
+void MyGL_requestTextureScreenSize(const char *name, uint32_t screen_pixels) {
+  auto find = named2DTextures.find(name ? name : "");
+  if (find == named2DTextures.end())
+    return;
+  streaming::demandSize(dynamic_cast<Texture2D*>(find->second.get()), screen_pixels);
+}
+
+void MyGL_setTextureBudget(uint64_t bytes) {
+  residency::setBudget(bytes);
+}
+
+uint64_t MyGL_trimTextures() {
+  return residency::trim();
+}
+
+static GLboolean createVirtualTexture(const char *func, const char *name, uint32_t w, uint32_t h, const char *format, uint32_t cache_pages, VirtualTexture::Provider provider) {
+  if (!name) {
+    utils::logout("%s error: texture has no alias", func);
+    return GL_FALSE;
+  }
+
+  auto pow2 = [](uint32_t v) {
+    return v >= VirtualTexture::pageSize && !(v & (v - 1));
+  };
+  if (!pow2(w) || !pow2(h)) {
+    utils::logout("%s error: virtual texture '%s' must be a power of two of at least %u (%u x %u)", func, name, VirtualTexture::pageSize, w, h);
+    return GL_FALSE;
+  }
+
+  if (colorFormatByName(format).blockBytes) {
+    utils::logout("%s error: virtual texture '%s' cannot use a compressed format", func, name);
+    return GL_FALSE;
+  }
+
+  auto vt = std::make_shared<VirtualTexture>(name, w, h, format, cache_pages, provider);
+  namedVirtualTextures[name] = vt;
+  named2DTextures[vt->physical->name] = vt->physical;
+  named2DTextures[vt->pageTable->name] = vt->pageTable;
+  vt->start();
+  if (MyGL_Debug_getChatty())
+    utils::logout("%s virtual texture '%s' created: %u levels, %u x %u pages, %u cache slots", func, name, vt->numLevels, vt->pagesX, vt->pagesY, vt->slotsX * vt->slotsY);
+  return GL_TRUE;
+}
+
+GLboolean MyGL_createVirtualTexture(const char *name, uint32_t w, uint32_t h, const char *format, uint32_t cache_pages, MyGL_VirtualTileFunc tile_func, void *user) {
+  if (!tile_func) {
+    utils::logout("%s error: virtual texture has no tile function", __func__);
+    return GL_FALSE;
+  }
+  return createVirtualTexture(__func__, name, w, h, format, cache_pages, [tile_func, user](uint32_t level, int32_t x, int32_t y, MyGL_Image tile) {
+    tile_func(user, level, x, y, tile);
+  });
+}
+
+GLboolean MyGL_createVirtualTextureFromImage(const char *name, MyGL_ROImage image, const char *format, uint32_t cache_pages) {
+  if (!image.w || !image.h || !image.pixels) {
+    utils::logout("%s error: virtual texture image is invalid", __func__);
+    return GL_FALSE;
+  }
+
+  // tiles are cut from a copy of the image and its mips kept in system memory
+  MyGL_MipOptions mipOptions = { .filter = MYGL_FILTER_BOX, .srgb = 0, .threads = 0, .borrowLevel0 = 0 };
+  auto chain = std::shared_ptr<MyGL_MipChain>(new MyGL_MipChain(MyGL_mipChainCreateFiltered(image, &mipOptions)), [](MyGL_MipChain *c) {
+    MyGL_mipChainFree(c);
+    delete c;
+  });
+  return createVirtualTexture(__func__, name, image.w, image.h, format, cache_pages, [chain](uint32_t level, int32_t x, int32_t y, MyGL_Image tile) {
+    const MyGL_Image &src = chain->levels[std::min<size_t>(level, chain->count - 1)];
+    for (uint32_t ty = 0; ty < tile.h; ty++) {
+      int32_t sy = std::clamp(y + (int32_t) ty, 0, (int32_t) src.h - 1);
+      const MyGL_Color *row = &src.pixels[(size_t) sy * src.w];
+      for (uint32_t tx = 0; tx < tile.w; tx++)
+        tile.pixels[(size_t) ty * tile.w + tx] = row[std::clamp(x + (int32_t) tx, 0, (int32_t) src.w - 1)];
+    }
+  });
+}
+
+void MyGL_virtualTextureFeedback(const char *name, const void *rgba_pixels, uint32_t count) {
+  if (!name || !rgba_pixels)
+    return;
+  auto f = namedVirtualTextures.find(name);
+  if (f == namedVirtualTextures.end()) {
+    utils::logout("%s warning: virtual texture '%s' not found", __func__, name);
+    return;
+  }
+  f->second->feedback((const uint8_t*) rgba_pixels, count);
+}
+
+uint32_t MyGL_updateVirtualTexture(const char *name, uint32_t max_uploads) {
+  if (!name)
+    return 0;
+  auto f = namedVirtualTextures.find(name);
+  if (f == namedVirtualTextures.end()) {
+    utils::logout("%s warning: virtual texture '%s' not found", __func__, name);
+    return 0;
+  }
+  return f->second->update(max_uploads);
+}
+
 GLboolean MyGL_createEmptyTexture2D(const char *name, uint32_t w, uint32_t h, const char *format, GLboolean filtered, GLboolean repeat) {
   if (!name) {
     utils::logout("%s error: texture has no alias", __func__);
@@ -428,6 +769,7 @@ GLboolean MyGL_createEmptyTexture2D(const char *name, uint32_t w, uint32_t h, co
   MyGL_ROImage image = { w, h, nullptr };  //for mip-mapped textures, pixels cannot be null
   auto tex = std::make_shared<Texture2D>(name, image, format, filtered, false, repeat);
   named2DTextures[name] = tex;
+  residency::track(tex);
   if (MyGL_Debug_getChatty()) {
     utils::logout("%s 2D texture (empty) '%s' created:", __func__, name);
     tex->logInfo();
@@ -436,6 +778,11 @@ GLboolean MyGL_createEmptyTexture2D(const char *name, uint32_t w, uint32_t h, co
 }
 
 GLboolean MyGL_createTexture2DArray(const char *name, MyGL_ROImage image_atlas, uint32_t num_rows, uint32_t num_cols, const char *format, GLboolean filtered, GLboolean mipmapped, GLboolean repeat) {
+  MyGL_TextureOptions options = { .filtered = filtered, .mipmapped = mipmapped, .repeat = repeat, .mipOptions = { }, .cacheKey = 0, .progressive = GL_FALSE, .immutable = GL_FALSE, .gpuMipmaps = GL_FALSE };
+  return MyGL_createTexture2DArrayEx(name, image_atlas, num_rows, num_cols, format, &options);
+}
+
+GLboolean MyGL_createTexture2DArrayEx(const char *name, MyGL_ROImage image_atlas, uint32_t num_rows, uint32_t num_cols, const char *format, const MyGL_TextureOptions *options) {
   if (!name) {
     utils::logout("%s error: texture has no alias", __func__);
     return GL_FALSE;
@@ -456,7 +803,12 @@ GLboolean MyGL_createTexture2DArray(const char *name, MyGL_ROImage image_atlas,
     return GL_FALSE;
   }
 
-  auto tex = std::make_shared<Texture2DArray>(name, image_atlas, num_rows, num_cols, format, filtered, mipmapped, repeat);
+  if (!options) {
+    utils::logout("%s error: texture '%s' has no options", __func__, name);
+    return GL_FALSE;
+  }
+
+  auto tex = std::make_shared<Texture2DArray>(name, image_atlas, num_rows, num_cols, format, *options);
   named3DTextures[name] = tex;
   if (MyGL_Debug_getChatty()) {
     utils::logout("%s 2D texture Array '%s' created:", __func__, name);
@@ -466,6 +818,38 @@ GLboolean MyGL_createTexture2DArray(const char *name, MyGL_ROImage image_atlas,
   return GL_TRUE;
 }
 
+GLboolean MyGL_generateMipmaps(const char *name) {
+  if (!name) {
+    utils::logout("%s error: no texture specified", __func__);
+    return GL_FALSE;
+  }
+
+  auto find2D = named2DTextures.find(name);
+  if (find2D != named2DTextures.end()) {
+    auto tex = std::dynamic_pointer_cast<Texture2D>(find2D->second);
+    if (!tex || !tex->generateMipmaps()) {
+      utils::logout("%s error: texture '%s' can't have mips generated (compressed or immutable without mips)", __func__, name);
+      return GL_FALSE;
+    }
+    return GL_TRUE;
+  }
+
+  auto find3D = named3DTextures.find(name);
+  if (find3D == named3DTextures.end()) {
+    utils::logout("%s warning: texture '%s' not found", __func__, name);
+    return GL_FALSE;
+  }
+  auto &tex = find3D->second;
+  if (!tex->mipmapped) {
+    utils::logout("%s error: texture array '%s' was created without mips", __func__, name);
+    return GL_FALSE;
+  }
+  glActiveTexture( MYGL_TEXTURE_USAGE_UNIT);
+  glBindTexture(tex->target, tex->tex);
+  glGenerateMipmap(tex->target);
+  return GL_TRUE;
+}
+
 void MyGL_clear(GLboolean color, GLboolean depth, GLboolean stencil) {
   GLuint flags = 0;
   if (color) {
@@ -706,3 +1090,21 @@ void MyGL_readPixels(int x, int y, uint32_t w, uint32_t h, MyGL_ReadFormat forma
   if (pixels)
     glReadPixels(x, y, w, h, format, type, pixels);
 }
+
+GLboolean MyGL_captureToFile(int x, int y, uint32_t w, uint32_t h, MyGL_CaptureFormat format, const char *path, MyGL_CaptureFunc done, void *user) {
+  if (!path) {
+    utils::logout("%s error: capture has no file", __func__);
+    return GL_FALSE;
+  }
+
+  if (!w || !h) {
+    utils::logout("%s error: capture '%s' is empty", __func__, path);
+    return GL_FALSE;
+  }
+
+  return capture::request(x, y, w, h, format, path, done, user);
+}
+
+uint32_t MyGL_pumpCaptures() {
+  return capture::pump();
+}
@@ -0,0 +1,163 @@
+#include "utils/log.h"
+
+#include "meshbin.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+namespace mygl {
+
+namespace meshbin {
+
+namespace {
+
+bool validType(uint32_t type) {
+  switch (type) {
+    case MYGL_VERTEX_CHAR:
+    case MYGL_VERTEX_UCHAR:
+    case MYGL_VERTEX_SHORT:
+    case MYGL_VERTEX_USHORT:
+    case MYGL_VERTEX_FLOAT:
+    case MYGL_VERTEX_INT:
+    case MYGL_VERTEX_UINT:
+    case MYGL_VERTEX_HALF_FLOAT:
+    case MYGL_VERTEX_INT_2_10_10_10_REV:
+      return true;
+  }
+  return false;
+}
+
+}
+
+bool parseHeader(const uint8_t *data, size_t size, size_t chunkSize, Header &header, std::vector<MyGL_VertexAttrib> &attribs, const char *source) {
+  if (size < sizeof(header))
+    return false;
+  memcpy(&header, data, sizeof(header));
+  if (memcmp(header.magic, magic, 4) || header.version != version) {
+    utils::logout("%s error: '%s' is not a version %u binary mesh", __func__, source, version);
+    return false;
+  }
+  if (!header.attribCount || header.attribCount > MYGL_MAX_VERTEX_ATTRIBS || size < sizeof(header) + header.attribCount * sizeof(Attrib)) {
+    utils::logout("%s error: '%s' has a bad attribute table", __func__, source);
+    return false;
+  }
+
+  attribs.clear();
+  uint64_t stride = 0;
+  for (uint32_t i = 0; i < header.attribCount; i++) {
+    Attrib a;
+    memcpy(&a, data + sizeof(header) + i * sizeof(Attrib), sizeof(a));
+    bool packed = a.type == MYGL_VERTEX_INT_2_10_10_10_REV;
+    if (!validType(a.type) || a.components < MYGL_X || a.components > MYGL_XYZW || (packed && a.components != MYGL_XYZW)) {
+      utils::logout("%s error: '%s' attribute %u is not supported", __func__, source, i);
+      return false;
+    }
+    attribs.push_back(MyGL_VertexAttrib { .type = (MyGL_VertexAttribType) a.type, .components = (MyGL_Components) a.components, .normalized = (GLboolean) (a.normalized != 0) });
+    stride += Vbo::Attrib(attribs.back()).sizeInBytes();
+  }
+
+  // both arrays inside the chunk, past the table and apart from each other
+  uint64_t tableEnd = sizeof(header) + header.attribCount * sizeof(Attrib);
+  uint64_t vertexEnd = header.vertexOffset + stride * header.vertexCount;
+  uint64_t indexEnd = header.indexOffset + (uint64_t) header.indexCount * sizeof(uint32_t);
+  uint64_t remapEnd = header.remapOffset + (header.remapOffset ? (uint64_t) header.vertexCount * sizeof(uint32_t) : 0);
+  bool apart = vertexEnd <= header.indexOffset || indexEnd <= header.vertexOffset;
+  bool remapApart = !header.remapOffset || (header.remapOffset >= tableEnd && remapEnd <= chunkSize && (remapEnd <= header.vertexOffset || vertexEnd <= header.remapOffset)
+      && (remapEnd <= header.indexOffset || indexEnd <= header.remapOffset));
+  if (header.vertexOffset < tableEnd || header.indexOffset < tableEnd || !apart || !remapApart || vertexEnd > chunkSize || indexEnd > chunkSize || header.indexCount % 3) {
+    utils::logout("%s error: '%s' is truncated or overlapping", __func__, source);
+    return false;
+  }
+  return true;
+}
+
+bool Reader::feed(uint64_t offset, const void *data, size_t size) {
+  const uint8_t *src = (const uint8_t*) data;
+  uint64_t end = offset + size;
+
+  // the header and attribute table may straddle calls, gather them first
+  if (!started) {
+    size_t pos = 0;
+    auto gather = [&](size_t want) {
+      size_t take = std::min(want - std::min(want, prefix.size()), size - pos);
+      prefix.insert(prefix.end(), src + pos, src + pos + take);
+      pos += take;
+      return prefix.size() >= want;
+    };
+    if (!gather(sizeof(Header)))
+      return true;
+    Header h;
+    memcpy(&h, prefix.data(), sizeof(h));
+    if (!gather(sizeof(Header) + std::min<uint32_t>(h.attribCount, MYGL_MAX_VERTEX_ATTRIBS) * sizeof(Attrib)))
+      return true;
+
+    std::vector<MyGL_VertexAttrib> attribs;
+    if (!parseHeader(prefix.data(), prefix.size(), chunkSize, header, attribs, source.c_str()))
+      return false;
+    vertexBytes = Vbo::Attribs(attribs).stride() * header.vertexCount;
+    indexBytes = (uint64_t) header.indexCount * sizeof(uint32_t);
+    remapBytes = header.remapOffset ? (uint64_t) header.vertexCount * sizeof(uint32_t) : 0;
+    remap.resize(remapBytes / sizeof(uint32_t));
+    if (!begin(header, attribs, vertices, indices))
+      return false;
+    started = true;
+  }
+
+  auto copy = [&](uint8_t *dst, uint64_t start, uint64_t bytes) {
+    uint64_t lo = std::max(offset, start), hi = std::min(end, start + bytes);
+    if (lo < hi) {
+      memcpy(dst + (lo - start), src + (lo - offset), hi - lo);
+      received += hi - lo;
+    }
+  };
+  copy(vertices, header.vertexOffset, vertexBytes);
+  copy(indices, header.indexOffset, indexBytes);
+  copy((uint8_t*) remap.data(), header.remapOffset, remapBytes);
+  return true;
+}
+
+bool Reader::complete() const {
+  if (!started || received != vertexBytes + indexBytes + remapBytes)
+    return false;
+  for (uint32_t r : remap)
+    if (r >= header.vertexCount)
+      return false;
+  return true;
+}
+
+bool store(const std::string &path, const Vbo &vbo, const Ibo &ibo, const std::vector<uint32_t> &remap) {
+  Header header = { { }, version, (uint32_t) vbo.count, (uint32_t) ibo.count, (uint32_t) vbo.attribs.count, 0, 0, 0 };
+  memcpy(header.magic, magic, 4);
+  std::vector<Attrib> table;
+  for (size_t i = 0; i < vbo.attribs.count; i++) {
+    const auto &a = vbo.attribs.attribs[i];
+    table.push_back(Attrib { .type = (uint32_t) a.type, .components = (uint32_t) a.components, .normalized = a.normalized ? 1u : 0u });
+  }
+  size_t vertexBytes = vbo.attribs.stride() * vbo.count;
+  header.vertexOffset = sizeof(header) + table.size() * sizeof(Attrib);
+  header.indexOffset = header.vertexOffset + ((vertexBytes + 3) & ~(size_t) 3);
+  if (remap.size() == vbo.count)
+    header.remapOffset = header.indexOffset + ibo.count * sizeof(uint32_t);
+
+  FILE *fp = fopen(path.c_str(), "wb");
+  if (!fp) {
+    utils::logout("%s error: cannot write '%s'", __func__, path.c_str());
+    return false;
+  }
+  const uint8_t pad[4] = { };
+  bool ok = fwrite(&header, sizeof(header), 1, fp) == 1;
+  ok = ok && fwrite(table.data(), sizeof(Attrib), table.size(), fp) == table.size();
+  ok = ok && fwrite(vbo.dataPtr.p, 1, vertexBytes, fp) == vertexBytes;
+  ok = ok && fwrite(pad, 1, header.indexOffset - header.vertexOffset - vertexBytes, fp) == header.indexOffset - header.vertexOffset - vertexBytes;
+  ok = ok && fwrite(ibo.dataPtr.p, sizeof(uint32_t), ibo.count, fp) == ibo.count;
+  ok = ok && (!header.remapOffset || fwrite(remap.data(), sizeof(uint32_t), remap.size(), fp) == remap.size());
+  ok = !fclose(fp) && ok;
+  if (!ok)
+    utils::logout("%s error: cannot write '%s'", __func__, path.c_str());
+  return ok;
+}
+
+}
+
+}
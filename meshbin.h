@@ -0,0 +1,67 @@
+#pragma once
+
+#include "bufferobjs.h"
+
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace mygl {
+
+// binary mesh chunks ('mesh.bin' in model archives), little-endian:
+// a header, attribCount attributes, interleaved vertices at vertexOffset and uint32 indices at indexOffset,
+// then for renumbered (fetch-optimized) meshes one uint32 per vertex at remapOffset: where each vertex of the source order went
+namespace meshbin {
+
+const char magic[4] = { 'M', 'G', 'L', 'M' };
+const uint32_t version = 1;
+
+struct Header {
+  char magic[4];
+  uint32_t version;
+  uint32_t vertexCount, indexCount;
+  uint32_t attribCount;
+  uint32_t vertexOffset, indexOffset;  // from the start of the chunk
+  uint32_t remapOffset;  // 0 when the vertices are in source order
+};
+
+struct Attrib {
+  uint32_t type, components, normalized;
+};
+
+// checks the header and attribute table against a chunk of chunkSize bytes
+bool parseHeader(const uint8_t *data, size_t size, size_t chunkSize, Header &header, std::vector<MyGL_VertexAttrib> &attribs, const char *source);
+
+// fed the chunk in order (e.g. from miniz's extract callback): once the header is in, begin hands out the
+// vertex and index memory and the payload is copied there as it arrives, nothing is staged in between
+// (the remap table, if any, lands in remap)
+struct Reader {
+  using Begin = std::function<bool(const Header&, const std::vector<MyGL_VertexAttrib>&, uint8_t *&vertices, uint8_t *&indices)>;
+
+  Reader(size_t chunkSize_, const char *source_, Begin begin_)
+      :
+      chunkSize(chunkSize_),
+      source(source_),
+      begin(begin_) {
+  }
+
+  bool feed(uint64_t offset, const void *data, size_t size);
+  // every vertex and index byte has arrived
+  bool complete() const;
+
+  size_t chunkSize;
+  std::string source;
+  Begin begin;
+  std::vector<uint8_t> prefix;
+  bool started = false;
+  Header header = { };
+  uint64_t vertexBytes = 0, indexBytes = 0, remapBytes = 0, received = 0;
+  uint8_t *vertices = nullptr, *indices = nullptr;
+  std::vector<uint32_t> remap;
+};
+
+bool store(const std::string &path, const Vbo &vbo, const Ibo &ibo, const std::vector<uint32_t> &remap);
+
+}
+
+}
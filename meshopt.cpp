@@ -0,0 +1,244 @@
+#include "meshopt.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace mygl {
+
+namespace meshopt {
+
+namespace {
+
+const uint32_t lruSize = 32;
+
+// Forsyth's weights: the last triangle's vertices score flat, older entries fall off along a 1.5 power curve,
+// and vertices with few triangles left are boosted so they get finished instead of stranded
+float vertexScore(int32_t cachePos, uint32_t liveTris) {
+  if (!liveTris)
+    return -1.0f;
+  float score = 0.0f;
+  if (cachePos >= 0)
+    score = cachePos < 3 ? 0.75f : powf(1.0f - (float) (cachePos - 3) / (lruSize - 3), 1.5f);
+  return score + 2.0f / sqrtf((float) liveTris);
+}
+
+struct Vec3 {
+  float x, y, z;
+};
+
+Vec3 position(const uint8_t *vertices, size_t stride, uint32_t i) {
+  Vec3 p;
+  memcpy(&p, vertices + i * stride, sizeof(p));
+  return p;
+}
+
+}
+
+CacheStats analyze(const uint32_t *indices, size_t count, size_t vertexCount, uint32_t cacheSize) {
+  std::vector<uint32_t> stamp(vertexCount, 0);
+  std::vector<bool> used(vertexCount, false);
+  uint32_t misses = 0, referenced = 0;
+  // a vertex stays in the FIFO until cacheSize more misses have pushed it out
+  for (size_t i = 0; i < count; i++) {
+    uint32_t v = indices[i];
+    if (!used[v]) {
+      used[v] = true;
+      referenced++;
+    }
+    if (!stamp[v] || misses - stamp[v] >= cacheSize) {
+      misses++;
+      stamp[v] = misses;
+    }
+  }
+  CacheStats stats = { 0.0f, 0.0f };
+  if (count >= 3)
+    stats.acmr = (float) misses / (float) (count / 3);
+  if (referenced)
+    stats.atvr = (float) misses / (float) referenced;
+  return stats;
+}
+
+void optimizeVertexCache(uint32_t *indices, size_t count, size_t vertexCount) {
+  size_t triCount = count / 3;
+  if (triCount < 2)
+    return;
+
+  // triangles per vertex, compacted as they are emitted
+  std::vector<uint32_t> live(vertexCount, 0), offsets(vertexCount + 1, 0), adjacency(count);
+  for (size_t i = 0; i < count; i++)
+    live[indices[i]]++;
+  for (size_t v = 0; v < vertexCount; v++)
+    offsets[v + 1] = offsets[v] + live[v];
+  std::vector<uint32_t> fill(offsets.begin(), offsets.end() - 1);
+  for (size_t i = 0; i < count; i++)
+    adjacency[fill[indices[i]]++] = (uint32_t) (i / 3);
+
+  std::vector<int32_t> cachePos(vertexCount, -1);
+  std::vector<float> score(vertexCount), triScore(triCount);
+  std::vector<bool> emitted(triCount, false);
+  for (size_t v = 0; v < vertexCount; v++)
+    score[v] = vertexScore(-1, live[v]);
+  for (size_t t = 0; t < triCount; t++)
+    triScore[t] = score[indices[t * 3]] + score[indices[t * 3 + 1]] + score[indices[t * 3 + 2]];
+
+  std::vector<uint32_t> out;
+  out.reserve(triCount * 3);
+  uint32_t cache[lruSize + 3], next[lruSize + 3];
+  uint32_t cacheCount = 0;
+  size_t cursor = 0;
+  int64_t best = 0;
+
+  while (out.size() < triCount * 3) {
+    if (best < 0) {
+      // nothing in the cache has triangles left, start over from the next one in file order
+      while (emitted[cursor])
+        cursor++;
+      best = (int64_t) cursor;
+    }
+    uint32_t t = (uint32_t) best;
+    emitted[t] = true;
+    const uint32_t *tri = &indices[t * 3];
+    for (int k = 0; k < 3; k++) {
+      uint32_t v = tri[k];
+      out.push_back(v);
+      uint32_t *list = &adjacency[offsets[v]];
+      uint32_t *end = std::remove(list, list + live[v], t);
+      live[v] = (uint32_t) (end - list);
+    }
+
+    // the triangle's vertices move to the front, the rest shift back and the overflow drops out
+    uint32_t n = 0;
+    for (int k = 0; k < 3; k++)
+      next[n++] = tri[k];
+    for (uint32_t i = 0; i < cacheCount; i++)
+      if (cache[i] != tri[0] && cache[i] != tri[1] && cache[i] != tri[2])
+        next[n++] = cache[i];
+    for (uint32_t i = lruSize; i < n; i++)
+      cachePos[next[i]] = -1;
+    cacheCount = std::min(n, lruSize);
+    memcpy(cache, next, cacheCount * sizeof(uint32_t));
+
+    // rescore what the move touched and pick the best triangle around the cache
+    for (uint32_t i = 0; i < n; i++) {
+      uint32_t v = next[i];
+      if (i < lruSize)
+        cachePos[v] = (int32_t) i;
+      float s = vertexScore(cachePos[v], live[v]);
+      float delta = s - score[v];
+      score[v] = s;
+      for (uint32_t j = 0; j < live[v]; j++)
+        triScore[adjacency[offsets[v] + j]] += delta;
+    }
+    best = -1;
+    float bestScore = -1.0f;
+    for (uint32_t i = 0; i < cacheCount; i++) {
+      uint32_t v = cache[i];
+      for (uint32_t j = 0; j < live[v]; j++) {
+        uint32_t a = adjacency[offsets[v] + j];
+        if (triScore[a] > bestScore) {
+          bestScore = triScore[a];
+          best = a;
+        }
+      }
+    }
+  }
+  memcpy(indices, out.data(), out.size() * sizeof(uint32_t));
+}
+
+void optimizeOverdraw(uint32_t *indices, size_t count, const uint8_t *vertices, size_t stride, size_t vertexCount) {
+  size_t triCount = count / 3;
+  if (triCount < 2)
+    return;
+
+  // a triangle missing on all three vertices starts a cluster, the order within one is the cache order
+  std::vector<size_t> starts;
+  std::vector<uint32_t> stamp(vertexCount, 0);
+  uint32_t misses = 0;
+  const uint32_t fifoSize = 16;
+  for (size_t t = 0; t < triCount; t++) {
+    uint32_t triMisses = 0;
+    for (int k = 0; k < 3; k++) {
+      uint32_t v = indices[t * 3 + k];
+      if (!stamp[v] || misses - stamp[v] >= fifoSize) {
+        misses++;
+        triMisses++;
+        stamp[v] = misses;
+      }
+    }
+    if (!t || triMisses == 3)
+      starts.push_back(t);
+  }
+  if (starts.size() < 2)
+    return;
+  starts.push_back(triCount);
+
+  Vec3 center = { 0.0f, 0.0f, 0.0f };
+  float totalArea = 0.0f;
+  std::vector<Vec3> centroids(starts.size() - 1), normals(starts.size() - 1);
+  for (size_t c = 0; c + 1 < starts.size(); c++) {
+    Vec3 sum = { 0.0f, 0.0f, 0.0f }, normal = { 0.0f, 0.0f, 0.0f };
+    float area = 0.0f;
+    for (size_t t = starts[c]; t < starts[c + 1]; t++) {
+      Vec3 a = position(vertices, stride, indices[t * 3]), b = position(vertices, stride, indices[t * 3 + 1]), d = position(vertices, stride, indices[t * 3 + 2]);
+      Vec3 e1 = { b.x - a.x, b.y - a.y, b.z - a.z }, e2 = { d.x - a.x, d.y - a.y, d.z - a.z };
+      Vec3 n = { e1.y * e2.z - e1.z * e2.y, e1.z * e2.x - e1.x * e2.z, e1.x * e2.y - e1.y * e2.x };
+      float w = sqrtf(n.x * n.x + n.y * n.y + n.z * n.z);
+      normal = { normal.x + n.x, normal.y + n.y, normal.z + n.z };
+      sum = { sum.x + (a.x + b.x + d.x) * w, sum.y + (a.y + b.y + d.y) * w, sum.z + (a.z + b.z + d.z) * w };
+      area += w;
+    }
+    float inv = area > 0.0f ? 1.0f / (3.0f * area) : 0.0f;
+    centroids[c] = { sum.x * inv, sum.y * inv, sum.z * inv };
+    normals[c] = normal;
+    center = { center.x + sum.x / 3.0f, center.y + sum.y / 3.0f, center.z + sum.z / 3.0f };
+    totalArea += area;
+  }
+  if (totalArea > 0.0f)
+    center = { center.x / totalArea, center.y / totalArea, center.z / totalArea };
+
+  // clusters on the outside facing out occlude the rest, draw them first
+  std::vector<float> sortKey(centroids.size());
+  std::vector<uint32_t> order(centroids.size());
+  for (size_t c = 0; c < centroids.size(); c++) {
+    Vec3 n = normals[c];
+    float len = sqrtf(n.x * n.x + n.y * n.y + n.z * n.z);
+    Vec3 d = { centroids[c].x - center.x, centroids[c].y - center.y, centroids[c].z - center.z };
+    sortKey[c] = len > 0.0f ? (d.x * n.x + d.y * n.y + d.z * n.z) / len : 0.0f;
+    order[c] = (uint32_t) c;
+  }
+  std::stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) {
+    return sortKey[a] > sortKey[b];
+  });
+
+  std::vector<uint32_t> out;
+  out.reserve(triCount * 3);
+  for (uint32_t c : order)
+    out.insert(out.end(), indices + starts[c] * 3, indices + starts[c + 1] * 3);
+  memcpy(indices, out.data(), out.size() * sizeof(uint32_t));
+}
+
+std::vector<uint32_t> optimizeVertexFetch(uint8_t *vertices, size_t stride, uint32_t *indices, size_t count, size_t vertexCount) {
+  const uint32_t unset = ~0u;
+  std::vector<uint32_t> remap(vertexCount, unset);
+  uint32_t next = 0;
+  for (size_t i = 0; i < count; i++) {
+    uint32_t &r = remap[indices[i]];
+    if (r == unset)
+      r = next++;
+    indices[i] = r;
+  }
+  for (uint32_t &r : remap)
+    if (r == unset)
+      r = next++;
+
+  std::vector<uint8_t> moved(vertexCount * stride);
+  for (size_t v = 0; v < vertexCount; v++)
+    memcpy(&moved[remap[v] * stride], vertices + v * stride, stride);
+  memcpy(vertices, moved.data(), moved.size());
+  return remap;
+}
+
+}
+
+}
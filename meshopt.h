@@ -0,0 +1,33 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace mygl {
+
+// index/vertex reordering for indexed triangle lists, run once at load (or before cooking a binary mesh)
+namespace meshopt {
+
+struct CacheStats {
+  float acmr;  // transformed vertices per triangle
+  float atvr;  // transformed vertices per referenced vertex, 1.0 is ideal
+};
+
+// simulated FIFO post-transform cache
+CacheStats analyze(const uint32_t *indices, size_t count, size_t vertexCount, uint32_t cacheSize = 16);
+
+// Forsyth's linear-speed ordering against an LRU cache
+void optimizeVertexCache(uint32_t *indices, size_t count, size_t vertexCount);
+
+// keeps the cache order inside clusters (cut where the cache starts cold) and sorts the clusters so the ones
+// facing away from the mesh center draw first; positions are 3 floats at the start of every vertex
+void optimizeOverdraw(uint32_t *indices, size_t count, const uint8_t *vertices, size_t stride, size_t vertexCount);
+
+// renumbers vertices by first use and moves them to match, unused ones go last in their old order
+// returns the new index of every old vertex
+std::vector<uint32_t> optimizeVertexFetch(uint8_t *vertices, size_t stride, uint32_t *indices, size_t count, size_t vertexCount);
+
+}
+
+}
@@ -1,71 +1,273 @@
 #include "utils/log.h"
+#include "utils/pixels.h"
 #include "utils/thirdparty/miniz/miniz.h"
-#include "utils/str.h"
-#include "utils/data.h"
+#include "utils/threads.h"
 
 #include "image.h"
 #include "model.h"
+#include "meshbin.h"
+#include "residency.h"
 #include "shaders.h"
+#include "textures.h"
+
+#include <algorithm>
+#include <charconv>
+#include <cmath>
 
 namespace mygl {
 
-void Model::loadMesh(const char *meshFileData, uint32_t meshFileSize) {
+MyGL_Vec3 modelMeshOffset = { 0.0f, 0.0f, 0.0f }, modelMeshScale = { 1.0f, 1.0f, 1.0f };
+
+const char *quantizedVertexLibrary = R"(
+// decoding for models loaded with MyGL_ModelOptions.quantize: attribute 0 is a normalized ushort4 over the
+// mesh bounds, 1 a normalized 2_10_10_10 word with the octahedral normal in xy, 2 half float uvs
+// q arrives in [0, 1], offset and scale are mygl.meshOffset and mygl.meshScale (the bounds' minimum and extent)
+vec3 q_position(vec4 q, vec3 offset, vec3 scale) {
+  return offset + q.xyz * scale;
+}
+
+vec3 q_octNormal(vec2 e) {
+  vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+  float t = max(-n.z, 0.0);
+  n.xy += vec2(n.x >= 0.0 ? -t : t, n.y >= 0.0 ? -t : t);
+  return normalize(n);
+}
+)";
+
+namespace {
+
+// 16 byte quantized vertex, see MyGL_ModelOptions.quantize
+struct QuantizedVertex {
+  uint16_t p[4];
+  uint32_t n;
+  uint16_t t[2];
+};
+
+// octahedral projection of a unit normal, x and y as snorm10 in a 2_10_10_10 word (z and w left zero)
+uint32_t packOctNormal(MyGL_Vec3 n) {
+  float l1 = fabsf(n.x) + fabsf(n.y) + fabsf(n.z);
+  float x = l1 > 0.0f ? n.x / l1 : 0.0f, y = l1 > 0.0f ? n.y / l1 : 0.0f;
+  if (n.z < 0.0f) {
+    float fx = (1.0f - fabsf(y)) * (x >= 0.0f ? 1.0f : -1.0f);
+    y = (1.0f - fabsf(x)) * (y >= 0.0f ? 1.0f : -1.0f);
+    x = fx;
+  }
+  auto snorm10 = [](float v) {
+    return (uint32_t) (int32_t) lroundf(std::clamp(v, -1.0f, 1.0f) * 511.0f) & 0x3ffu;
+  };
+  return snorm10(x) | (snorm10(y) << 10);
+}
+
+MyGL_Vec3 unpackOctNormal(uint32_t w) {
+  auto snorm10 = [](uint32_t bits) {
+    return std::max((float) ((int32_t) (bits << 22) >> 22) / 511.0f, -1.0f);
+  };
+  MyGL_Vec3 n;
+  n.x = snorm10(w);
+  n.y = snorm10(w >> 10);
+  n.z = 1.0f - fabsf(n.x) - fabsf(n.y);
+  float t = std::max(-n.z, 0.0f);
+  n.x += n.x >= 0.0f ? -t : t;
+  n.y += n.y >= 0.0f ? -t : t;
+  float len = sqrtf(n.x * n.x + n.y * n.y + n.z * n.z);
+  return len > 0.0f ? MyGL_Vec3 { n.x / len, n.y / len, n.z / len } : n;
+}
+
+// skips blanks, then n comma separated numbers; null when the line has fewer
+template<typename T>
+const char* parseList(const char *p, const char *end, T *out, int n) {
+  while (p < end && (*p == ' ' || *p == '\t'))
+    p++;
+  for (int i = 0; i < n; i++) {
+    if (i) {
+      if (p == end || *p != ',')
+        return nullptr;
+      p++;
+    }
+    auto [next, ec] = std::from_chars(p, end, out[i]);
+    if (ec != std::errc())
+      return nullptr;
+    p = next;
+  }
+  return p;
+}
+
+// a text mesh/frame split into newline-aligned chunks, one per worker; the file is scanned where it lies,
+// a counting pass gives every chunk its first 'v'/'f' index so the parsing pass can write without locks
+struct TextChunks {
+  static const size_t minChunk = 256 * 1024;
+
+  std::vector<std::pair<const char*, const char*> > chunks;
+  std::vector<uint32_t> firsts[2];
+
+  // maxChunks = 0 uses every worker, 1 parses on the calling thread
+  TextChunks(const char *data, size_t size, size_t maxChunks = 0) {
+    const char *end = data + size;
+    size_t n = std::max<size_t>(1, std::min<size_t>(maxChunks ? maxChunks : utils::sharedPool().size() + 1, size / minChunk));
+    for (const char *p = data; p < end;) {
+      const char *cut = chunks.size() + 1 == n ? end : std::min(end, p + size / n);
+      cut = cut < end ? (const char*) memchr(cut, '\n', end - cut) : end;
+      cut = cut ? std::min(end, cut + 1) : end;
+      chunks.push_back( { p, cut });
+      p = cut;
+    }
+    if (chunks.empty())
+      chunks.push_back( { data, data });
+  }
 
-  utils::CharStream s(meshFileData, meshFileSize);
+  // calls f(kind, after "v "/"f ", end of line) for every vertex and face line in a chunk
+  template<typename F>
+  void forEachLine(size_t chunk, F &&f) const {
+    const char *p = chunks[chunk].first, *end = chunks[chunk].second;
+    while (p < end) {
+      const char *eol = (const char*) memchr(p, '\n', end - p);
+      if (!eol)
+        eol = end;
+      if (eol - p >= 2 && p[1] == ' ' && (p[0] == 'v' || p[0] == 'f'))
+        f(p[0], p + 2, eol);
+      p = eol + 1;
+    }
+  }
+
+  template<typename F>
+  void parse(F &&f) const {
+    if (chunks.size() == 1) {
+      f(0);
+      return;
+    }
+    utils::TaskGroup tasks;
+    for (size_t i = 0; i < chunks.size(); i++)
+      tasks.enqueue([&f, i]() {
+        f(i);
+      });
+    tasks.wait();
+  }
 
-  uint32_t vCount = 0;
-  uint32_t tCount = 0;
+  // counts kind ('v' or 'f') lines, remembering the running total at each chunk
+  uint32_t count(char kind) {
+    std::vector<uint32_t> &first = firsts[kind == 'f'];
+    first.assign(chunks.size(), 0);
+    parse([&](size_t chunk) {
+      uint32_t n = 0;
+      forEachLine(chunk, [&](char k, const char*, const char*) {
+        n += k == kind;
+      });
+      first[chunk] = n;
+    });
+    uint32_t total = 0;
+    for (uint32_t &n : first) {
+      uint32_t c = n;
+      n = total;
+      total += c;
+    }
+    return total;
+  }
 
-  for (uint32_t i = 0; i < s.lineCount(); i++) {
-    std::string line = s.getLine(i);
-    if (0 == strncmp(line.c_str(), "v ", 2))
-      vCount++;
-    if (0 == strncmp(line.c_str(), "f ", 2))
-      tCount++;
+  uint32_t first(size_t chunk, char kind) const {
+    return firsts[kind == 'f'][chunk];
   }
+};
+
+// keeps the skin's entry as the archive stores it (deflated, a fraction of the texture) so the residency budget
+// can evict the skin and inflate and decode it again when it is next bound
+residency::Reload reloadSkin(mz_zip_archive *zip, const mz_zip_archive_file_stat &stat) {
+  size_t storedSize = 0;
+  void *stored = mz_zip_reader_extract_to_heap(zip, stat.m_file_index, &storedSize, MZ_ZIP_FLAG_COMPRESSED_DATA);
+  if (!stored)
+    return nullptr;
+  auto entry = std::make_shared<const std::vector<uint8_t> >((const uint8_t*) stored, (const uint8_t*) stored + storedSize);
+  free(stored);
+  bool deflated = stat.m_method == MZ_DEFLATED;
+  return [entry, deflated](const std::shared_ptr<Texture2D> &tex) {
+    size_t size = entry->size();
+    void *inflated = deflated ? tinfl_decompress_mem_to_heap(entry->data(), entry->size(), &size, 0) : nullptr;
+    MyGL_Image image = {};
+    if (!deflated || inflated)
+      image = MyGL_imageFromBMPData(deflated ? inflated : entry->data(), size, tex->name.c_str());
+    free(inflated);
+    if (!image.pixels) {
+      utils::logout("%s error: cannot reload skin '%s'", __func__, tex->name.c_str());
+      return;
+    }
+    Texture2D fresh(tex->name.c_str(), toRo(image), "rgb10a2", true, true, true);
+    MyGL_imageFree(&image);
+    tex->adopt(fresh.tex, fresh.sizes[0], fresh.sizes[1], fresh.numMips);
+    fresh.tex = 0;
+  };
+}
+
+// "<path>/frame_<n>.txt" -> n
+bool frameNumber(std::string_view fileName, uint32_t &frameNo) {
+  size_t at = fileName.rfind("frame_");
+  if (at == std::string_view::npos)
+    return false;
+  const char *p = fileName.data() + at + 6, *end = fileName.data() + fileName.size();
+  auto [next, ec] = std::from_chars(p, end, frameNo);
+  return ec == std::errc() && std::string_view(next, end - next) == ".txt";
+}
 
+}
+
+void Model::createMeshBuffers(uint32_t vCount, uint32_t iCount, const std::vector<MyGL_VertexAttrib> &attribs) {
   auto vboName = name + "/mesh-vbo";
   auto iboName = name + "/mesh-ibo";
-
-  std::vector<MyGL_VertexAttrib> attribs;
-  attribs.push_back(MyGL_VertexAttrib { .type = MYGL_VERTEX_FLOAT, .components = MYGL_XYZ, .normalized = false });
-  attribs.push_back(MyGL_VertexAttrib { .type = MYGL_VERTEX_FLOAT, .components = MYGL_XYZ, .normalized = false });
-  attribs.push_back(MyGL_VertexAttrib { .type = MYGL_VERTEX_FLOAT, .components = MYGL_XY, .normalized = false });
   meshVbo = std::make_shared<Vbo>(vCount, attribs);
-  meshIbo = std::make_shared<Ibo>(nullptr, tCount * 3);
+  meshIbo = std::make_shared<Ibo>(nullptr, iCount);
   namedVbos[vboName] = meshVbo;
   namedIbos[iboName] = meshIbo;
 
   if (MyGL_Debug_getChatty()) {
     utils::logout(" - created vbo '%s'(%u vertices)", vboName.data(), vCount);
-    utils::logout(" - created ibo '%s'(%u triangles)", iboName.data(), tCount);
+    utils::logout(" - created ibo '%s'(%u triangles)", iboName.data(), iCount / 3);
   }
+}
 
-  int vi = 0;
-  int ti = 0;
-  auto vboStream = MyGL_vboStream(vboName.c_str());
-  auto iboStream = MyGL_iboStream(iboName.c_str());
-  Vertex *verts = (Vertex*) vboStream.data;
-  Triangle *tris = (Triangle*) iboStream.data;
-  for (uint32_t i = 0; i < s.lineCount(); i++) {
-    std::string line = s.getLine(i);
-    if (0 == strncmp(line.c_str(), "v ", 2)) {
-      strutils::Tokenizer<256, 4> tokenizer;
-      tokenizer.tokenize(line.c_str(), " \n");
-      sscanf(tokenizer[1].data(), "%f,%f,%f", &verts[vi].p.x, &verts[vi].p.y, &verts[vi].p.z);
-      sscanf(tokenizer[2].data(), "%f,%f,%f", &verts[vi].n.x, &verts[vi].n.y, &verts[vi].n.z);
-      sscanf(tokenizer[3].data(), "%f,%f", &verts[vi].t.x, &verts[vi].t.y);
-      vi++;
-    }
-    if (0 == strncmp(line.c_str(), "f ", 2)) {
-      strutils::Tokenizer<128, 2> tokenizer;
-      tokenizer.tokenize(line.c_str(), " \n");
-      sscanf(tokenizer[1].data(), "%u,%u,%u", &tris[ti].i, &tris[ti].j, &tris[ti].k);
-      ti++;
+void Model::releaseMeshBuffers() {
+  namedVbos.erase(name + "/mesh-vbo");
+  namedIbos.erase(name + "/mesh-ibo");
+  meshVbo = nullptr;
+  meshIbo = nullptr;
+}
+
+bool Model::loadMesh(const char *meshFileData, uint32_t meshFileSize) {
+  TextChunks text(meshFileData, meshFileSize);
+  uint32_t vCount = text.count('v');
+  uint32_t tCount = text.count('f');
+
+  std::vector<MyGL_VertexAttrib> attribs;
+  attribs.push_back(MyGL_VertexAttrib { .type = MYGL_VERTEX_FLOAT, .components = MYGL_XYZ, .normalized = false });
+  attribs.push_back(MyGL_VertexAttrib { .type = MYGL_VERTEX_FLOAT, .components = MYGL_XYZ, .normalized = false });
+  attribs.push_back(MyGL_VertexAttrib { .type = MYGL_VERTEX_FLOAT, .components = MYGL_XY, .normalized = false });
+  createMeshBuffers(vCount, tCount * 3, attribs);
+
+  // each chunk writes from its prefix offset straight into the shadow buffers
+  Vertex *verts = (Vertex*) meshVbo->dataPtr.p;
+  Triangle *tris = (Triangle*) meshIbo->dataPtr.p;
+  text.parse([&](size_t chunk) {
+    uint32_t vi = text.first(chunk, 'v');
+    uint32_t ti = text.first(chunk, 'f');
+    text.forEachLine(chunk, [&](char kind, const char *p, const char *end) {
+      if (kind == 'v') {
+        Vertex &v = verts[vi++];
+        v = Vertex { };
+        if ((p = parseList(p, end, v.p.f3, 3)) && (p = parseList(p, end, v.n.f3, 3)))
+          parseList(p, end, v.t.f2, 2);
+      } else {
+        Triangle &t = tris[ti++];
+        t = Triangle { };
+        parseList(p, end, t.indices, 3);
+      }
+    });
+  });
+
+  // the optimizers index per-vertex tables with these, nothing past the vertices gets through
+  for (size_t i = 0; i < meshIbo->count; i++)
+    if (meshIbo->dataPtr.uint32s[i] >= vCount) {
+      utils::logout(" - error: mesh of '%s' has face indices past its %u vertices", name.c_str(), vCount);
+      releaseMeshBuffers();
+      return false;
     }
-  }
-  MyGL_vboPush(vboName.c_str());
-  MyGL_iboPush(iboName.c_str());
+  return true;
 }
 /*
  void Model::loadFrames(const char *framesFileData, uint32_t framesFileSize) {
@@ -125,44 +327,153 @@ void Model::loadMesh(const char *meshFileData, uint32_t meshFileSize) {
 
  }
  */
-void Model::loadFrame(const char *framesFileData, uint32_t framesFileSize, uint32_t frameNo) {
-  utils::CharStream s(framesFileData, framesFileSize);
+// miniz hands the inflated chunk over piece by piece (a stored entry in one piece, straight from the archive),
+// each piece is copied into the vbo/ibo shadow buffers without the whole file ever sitting on the heap
+bool Model::loadMeshBinary(mz_zip_archive *zip, uint32_t fileIndex, size_t size, const char *source) {
+  meshbin::Reader reader(size, source, [this](const meshbin::Header &header, const std::vector<MyGL_VertexAttrib> &attribs, uint8_t *&vertices, uint8_t *&indices) {
+    createMeshBuffers(header.vertexCount, header.indexCount, attribs);
+    vertices = meshVbo->dataPtr.bytes;
+    indices = meshIbo->dataPtr.bytes;
+    return true;
+  });
+  auto feed = [](void *opaque, mz_uint64 offset, const void *data, size_t n) -> size_t {
+    return ((meshbin::Reader*) opaque)->feed(offset, data, n) ? n : 0;
+  };
+  bool ok = mz_zip_reader_extract_to_callback(zip, fileIndex, feed, &reader, 0) && reader.complete();
+  for (size_t i = 0; ok && i < (meshIbo ? meshIbo->count : 0); i++)
+    ok = meshIbo->dataPtr.uint32s[i] < meshVbo->count;
+  if (!ok) {
+    utils::logout(" - error: binary mesh '%s' is invalid", source);
+    releaseMeshBuffers();
+    return false;
+  }
+  vertexRemap = std::move(reader.remap);
+  return true;
+}
 
-  Vertex *verts = (Vertex*) meshVbo->dataPtr.p;
-  auto vCount = meshVbo->count;
+void Model::finishMesh() {
+  uint32_t *indices = meshIbo->dataPtr.uint32s;
+  size_t count = meshIbo->count, vCount = meshVbo->count, stride = meshVbo->attribs.stride();
+  bool optimized = options.optimizeVertexCache || options.optimizeOverdraw || options.optimizeVertexFetch;
+  if (optimized) {
+    statsBefore = meshopt::analyze(indices, count, vCount);
+    statsValid = true;
+  }
 
-  std::vector<FrameVertex> frameVertices;
-  frameVertices.reserve(vCount);
-
-  for (uint32_t i = 0; i < s.lineCount(); i++) {
-    std::string line = s.getLine(i);
-    if (0 == strncmp(line.c_str(), "v ", 2)) {
-      strutils::Tokenizer<128, 3> tokenizer;
-      tokenizer.tokenize(line.c_str(), " \n");
-      FrameVertex vertex;
-      sscanf(tokenizer[1].data(), "%f,%f,%f", &vertex.p.x, &vertex.p.y, &vertex.p.z);
-      sscanf(tokenizer[2].data(), "%f,%f,%f", &vertex.n.x, &vertex.n.y, &vertex.n.z);
-      frameVertices.push_back(vertex);
-      if (frameVertices.size() == vCount)
-        break;
-    }
+  if (options.optimizeVertexCache)
+    meshopt::optimizeVertexCache(indices, count, vCount);
+  const auto &position = meshVbo->attribs.attribs[0];
+  if (options.optimizeOverdraw && position.type == MYGL_VERTEX_FLOAT && position.components >= MYGL_XYZ)
+    meshopt::optimizeOverdraw(indices, count, meshVbo->dataPtr.bytes, stride, vCount);
+  if (options.optimizeVertexFetch) {
+    auto remap = meshopt::optimizeVertexFetch(meshVbo->dataPtr.bytes, stride, indices, count, vCount);
+    // a cooked mesh may have been renumbered already, frames still come in the archive's order
+    if (vertexRemap.empty())
+      vertexRemap = std::move(remap);
+    else
+      for (uint32_t &r : vertexRemap)
+        r = remap[r];
+  }
+  if (optimized) {
+    statsAfter = meshopt::analyze(indices, count, vCount);
+    if (MyGL_Debug_getChatty())
+      utils::logout(" - mesh optimized: ACMR %.3f -> %.3f, ATVR %.3f -> %.3f", statsBefore.acmr, statsAfter.acmr, statsBefore.atvr, statsAfter.atvr);
   }
+  if (options.quantize && !quantizeMesh())
+    utils::logout(" - warning: mesh of '%s' is not in the float layout, left unquantized", name.c_str());
+  meshVbo->push();
+  meshIbo->push();
+}
 
-  std::string frameName = name + std::string("/frame-tbo") + std::to_string(frameNo);
-  MyGL_createTbo(frameName.c_str(), vCount * 2, MYGL_XYZ);
-  frameTbos.push_back(namedTbos[frameName]);
+bool Model::quantizeMesh() {
+  const auto &attribs = meshVbo->attribs;
+  auto isFloat = [&](size_t i, MyGL_Components components) {
+    return attribs.attribs[i].type == MYGL_VERTEX_FLOAT && attribs.attribs[i].components == components;
+  };
+  if (quantized || attribs.count != 3 || !isFloat(0, MYGL_XYZ) || !isFloat(1, MYGL_XYZ) || !isFloat(2, MYGL_XY))
+    return false;
+
+  const Vertex *verts = (const Vertex*) meshVbo->dataPtr.p;
+  size_t vCount = meshVbo->count;
+  MyGL_Vec3 lo = vCount ? verts[0].p : MyGL_Vec3 { }, hi = lo;
+  for (size_t i = 1; i < vCount; i++)
+    for (int k = 0; k < 3; k++) {
+      lo.f3[k] = std::min(lo.f3[k], verts[i].p.f3[k]);
+      hi.f3[k] = std::max(hi.f3[k], verts[i].p.f3[k]);
+    }
 
+  std::vector<MyGL_VertexAttrib> layout;
+  layout.push_back(MyGL_VertexAttrib { .type = MYGL_VERTEX_USHORT, .components = MYGL_XYZW, .normalized = true });
+  layout.push_back(MyGL_VertexAttrib { .type = MYGL_VERTEX_INT_2_10_10_10_REV, .components = MYGL_XYZW, .normalized = true });
+  layout.push_back(MyGL_VertexAttrib { .type = MYGL_VERTEX_HALF_FLOAT, .components = MYGL_XY, .normalized = false });
+  auto vbo = std::make_shared<Vbo>(vCount, layout);
+
+  // the shader reads the normalized ushorts as q / 65535 in [0, 1], so its scale is the extent itself
+  QuantizedVertex *out = (QuantizedVertex*) vbo->dataPtr.p;
   for (size_t i = 0; i < vCount; i++) {
-    frameTbos.back()->dataPtr.vec3s[i * 2 + 0] = verts[i].p;
-    frameTbos.back()->dataPtr.vec3s[i * 2 + 1] = verts[i].n;
+    const Vertex &v = verts[i];
+    QuantizedVertex &q = out[i];
+    for (int k = 0; k < 3; k++) {
+      float extent = hi.f3[k] - lo.f3[k];
+      q.p[k] = extent > 0.0f ? (uint16_t) lroundf((v.p.f3[k] - lo.f3[k]) / extent * 65535.0f) : 0;
+    }
+    q.p[3] = 0;
+    q.n = packOctNormal(v.n);
+    q.t[0] = utils::pixels::floatToHalf(v.t.x);
+    q.t[1] = utils::pixels::floatToHalf(v.t.y);
   }
-  int i = 0;
-  for (auto vert : frameVertices) {
-    frameTbos.back()->dataPtr.vec3s[i++] = vert.p;
-    frameTbos.back()->dataPtr.vec3s[i++] = vert.n;
+  boundsMin = lo;
+  for (int k = 0; k < 3; k++)
+    boundsScale.f3[k] = hi.f3[k] - lo.f3[k];
+
+  meshVbo = vbo;
+  namedVbos[name + "/mesh-vbo"] = meshVbo;
+  quantized = true;
+  if (MyGL_Debug_getChatty())
+    utils::logout(" - mesh quantized: %zu -> %zu bytes per vertex", sizeof(Vertex), sizeof(QuantizedVertex));
+  return true;
+}
+
+Model::FrameVertex Model::restVertex(size_t i) const {
+  if (!quantized) {
+    const Vertex &v = ((const Vertex*) meshVbo->dataPtr.p)[i];
+    return FrameVertex { .p = v.p, .n = v.n };
   }
-  frameTbos.back()->push();
+  const QuantizedVertex &q = ((const QuantizedVertex*) meshVbo->dataPtr.p)[i];
+  FrameVertex v;
+  for (int k = 0; k < 3; k++)
+    v.p.f3[k] = boundsMin.f3[k] + (float) q.p[k] / 65535.0f * boundsScale.f3[k];
+  v.n = unpackOctNormal(q.n);
+  return v;
+}
 
+std::shared_ptr<Tbo> Model::createFrameTbo(uint32_t frameNo) {
+  std::string frameName = name + std::string("/frame-tbo") + std::to_string(frameNo);
+  MyGL_createTbo(frameName.c_str(), meshVbo->count * 2, MYGL_XYZ);
+  return namedTbos[frameName];
+}
+
+void Model::parseFrame(const char *framesFileData, uint32_t framesFileSize, Tbo &tbo) const {
+  auto vCount = meshVbo->count;
+
+  // vertices the frame leaves out keep the mesh's, the rest are parsed in place
+  FrameVertex *frame = (FrameVertex*) tbo.dataPtr.p;
+  for (size_t i = 0; i < vCount; i++)
+    frame[i] = restVertex(i);
+
+  TextChunks text(framesFileData, framesFileSize, 1);
+  text.count('v');
+  text.parse([&](size_t chunk) {
+    size_t vi = text.first(chunk, 'v');
+    text.forEachLine(chunk, [&](char kind, const char *p, const char *end) {
+      if (kind != 'v' || vi >= vCount)
+        return;
+      FrameVertex &v = frame[vertexRemap.empty() ? vi : vertexRemap[vi]];
+      vi++;
+      if ((p = parseList(p, end, v.p.f3, 3)))
+        parseList(p, end, v.n.f3, 3);
+    });
+  });
 }
 
 bool Model::loadZipped(void *zipContent, uint32_t size, std::string_view name_) {
@@ -176,16 +487,34 @@ bool Model::loadZipped(void *zipContent, uint32_t size, std::string_view name_)
   name = std::string(name_);
 
   uint32_t numFiles = mz_zip_reader_get_num_files(&zip);
+  // a binary mesh wins over a text one, the text one is the fallback when the binary is missing or bad
+  int32_t meshBin = -1, meshTxt = -1;
+  for (uint32_t i = 0; i < numFiles; i++) {
+    mz_zip_archive_file_stat fileStat;
+    if (mz_zip_reader_file_stat(&zip, i, &fileStat)) {
+      std::string_view fileName(fileStat.m_filename);
+      if (fileName.find("mesh.bin") != std::string::npos)
+        meshBin = i;
+      else if (fileName.find("mesh.txt") != std::string::npos)
+        meshTxt = i;
+    }
+  }
+  mz_zip_archive_file_stat meshStat;
+  bool meshLoaded = meshBin >= 0 && mz_zip_reader_file_stat(&zip, meshBin, &meshStat) && loadMeshBinary(&zip, meshBin, meshStat.m_uncomp_size, meshStat.m_filename);
+  if (!meshLoaded && meshTxt >= 0 && mz_zip_reader_file_stat(&zip, meshTxt, &meshStat)) {
+    size_t actualSize = meshStat.m_uncomp_size;
+    void *dataPtr = mz_zip_reader_extract_to_heap(&zip, meshTxt, &actualSize, 0);
+    if (dataPtr)
+      loadMesh((const char*) dataPtr, actualSize);
+    free(dataPtr);
+  }
+  if (meshVbo && meshIbo)
+    finishMesh();
+
   for (uint32_t i = 0; i < numFiles; i++) {
     mz_zip_archive_file_stat fileStat;
     if (mz_zip_reader_file_stat(&zip, i, &fileStat)) {
       std::string fileName(fileStat.m_filename);
-      if (fileName.find("mesh.txt") != std::string::npos) {
-        size_t actualSize = fileStat.m_uncomp_size;
-        void *dataPtr = mz_zip_reader_extract_file_to_heap(&zip, fileStat.m_filename, &actualSize, 0);
-        loadMesh((const char*) dataPtr, actualSize);
-        free(dataPtr);
-      }
       size_t loc = fileName.find("skin.bmp");
       if (loc != std::string::npos) {
         size_t actualSize = fileStat.m_uncomp_size;
@@ -198,6 +527,9 @@ bool Model::loadZipped(void *zipContent, uint32_t size, std::string_view name_)
         fileName = name + "/skin.bmp";
         auto image = MyGL_imageFromBMPData(dataPtr, actualSize, fileName.c_str());
         MyGL_createTexture2D(fileName.c_str(), toRo(image), "rgb10a2", GL_TRUE, GL_TRUE, GL_TRUE);
+        auto skin = named2DTextures.find(fileName);
+        if (auto tex = skin != named2DTextures.end() ? std::dynamic_pointer_cast<Texture2D>(skin->second) : nullptr)
+          residency::track(tex, reloadSkin(&zip, fileStat));
         textureNames.push_back(std::move(fileName));
         if (MyGL_Debug_getChatty())
           utils::logout(" - loading skin '%s'", textureNames.back().c_str());
@@ -206,25 +538,64 @@ bool Model::loadZipped(void *zipContent, uint32_t size, std::string_view name_)
     }
   }
 
-// Read frames after the mesh has been build
-  for (uint32_t i = 0; i < numFiles; i++) {
+  // frames after the mesh has been built: the tbos are made here, the workers inflate and parse into their shadow memory
+  // with an archive reader each (miniz readers aren't shared across threads), and only the pushes are left for this thread
+  struct FrameJob {
+    uint32_t fileIndex;
+    uint32_t frameNo;
+    std::shared_ptr<Tbo> tbo;
+    bool ok;
+  };
+  std::vector<FrameJob> frames;
+  for (uint32_t i = 0; meshVbo && i < numFiles; i++) {
     mz_zip_archive_file_stat fileStat;
-    if (mz_zip_reader_file_stat(&zip, i, &fileStat)) {
-      std::string fileName(fileStat.m_filename);
-      utils::logout(" - checking against file '%s'...", fileName.c_str());
-      for (size_t i = 0; i < 256; i++) {
-        std::string lookFor = "frame_" + std::to_string(i) + ".txt";
-        if (fileName.find(lookFor.data()) != std::string::npos) {
-          if (MyGL_Debug_getChatty())
-            utils::logout(" - loading frame '%s'", lookFor.c_str());
-          size_t actualSize = fileStat.m_uncomp_size;
-          void *dataPtr = mz_zip_reader_extract_file_to_heap(&zip, fileStat.m_filename, &actualSize, 0);
-          loadFrame((const char*) dataPtr, actualSize, i);
-          free(dataPtr);
-        }
+    uint32_t frameNo;
+    if (!mz_zip_reader_file_stat(&zip, i, &fileStat) || !frameNumber(fileStat.m_filename, frameNo))
+      continue;
+    // one tbo per frame number, a second entry would replace the first one's name
+    if (std::any_of(frames.begin(), frames.end(), [&](const FrameJob &frame) {
+      return frame.frameNo == frameNo;
+    })) {
+      utils::logout(" - warning: skipping duplicate frame '%s'", fileStat.m_filename);
+      continue;
+    }
+    frames.push_back(FrameJob { .fileIndex = i, .frameNo = frameNo, .tbo = createFrameTbo(frameNo), .ok = false });
+  }
+  size_t groups = std::min<size_t>(frames.size(), utils::sharedPool().size() + 1);
+  utils::TaskGroup tasks;
+  for (size_t g = 0; g < groups; g++)
+    tasks.enqueue([&, g]() {
+      mz_zip_archive reader;
+      memset(&reader, 0, sizeof(reader));
+      if (!mz_zip_reader_init_mem(&reader, zipContent, size, 0))
+        return;
+      for (size_t f = g; f < frames.size(); f += groups) {
+        size_t actualSize = 0;
+        void *dataPtr = mz_zip_reader_extract_to_heap(&reader, frames[f].fileIndex, &actualSize, 0);
+        if (!dataPtr)
+          continue;
+        parseFrame((const char*) dataPtr, actualSize, *frames[f].tbo);
+        frames[f].ok = true;
+        free(dataPtr);
       }
+      mz_zip_reader_end(&reader);
+    });
+  tasks.wait();
+  for (auto &frame : frames) {
+    if (!frame.ok) {
+      utils::logout(" - error: cannot extract frame entry %u", frame.fileIndex);
+      auto named = std::find_if(namedTbos.begin(), namedTbos.end(), [&](const auto &named) {
+        return named.second == frame.tbo;
+      });
+      if (named != namedTbos.end())
+        namedTbos.erase(named);
+      continue;
     }
+    frame.tbo->push();
+    frameTbos.push_back(frame.tbo);
   }
+  if (MyGL_Debug_getChatty() && !frames.empty())
+    utils::logout(" - loaded %zu frame(s)", frameTbos.size());
   mz_zip_reader_end(&zip);
   return meshVbo && meshIbo;  // && textureNames.size();
 }
@@ -232,7 +603,13 @@ bool Model::loadZipped(void *zipContent, uint32_t size, std::string_view name_)
 }
 
 GLboolean MyGL_loadModelArchive(const char *name, void *data, uint32_t size) {
+  return MyGL_loadModelArchiveEx(name, data, size, nullptr);
+}
+
+GLboolean MyGL_loadModelArchiveEx(const char *name, void *data, uint32_t size, const MyGL_ModelOptions *options) {
   std::shared_ptr<mygl::Model> model = std::make_shared<mygl::Model>();
+  if (options)
+    model->options = *options;
   if (MyGL_Debug_getChatty())
     utils::logout("%s Loading Model '%s':", __func__, name);
   if (!model->loadZipped(data, size, name)) {
@@ -267,6 +644,39 @@ void MyGL_setModelArchiveTextures(const char *name, uint32_t skin_no, uint32_t s
   }
 }
 
+GLboolean MyGL_saveModelArchiveMesh(const char *name, const char *path) {
+  auto it = mygl::namedModels.find(name);
+  if (it == mygl::namedModels.end() || !it->second->meshVbo || !it->second->meshIbo) {
+    utils::logout("%s - error: couldn't find model archive '%s'", __func__, name);
+    return GL_FALSE;
+  }
+  // the chunk has no room for the bounds, cook from an unquantized load
+  if (it->second->quantized) {
+    utils::logout("%s - error: model archive '%s' is quantized", __func__, name);
+    return GL_FALSE;
+  }
+  return mygl::meshbin::store(path, *it->second->meshVbo, *it->second->meshIbo, it->second->vertexRemap) ? GL_TRUE : GL_FALSE;
+}
+
+GLboolean MyGL_modelArchiveCacheStats(const char *name, MyGL_MeshCacheStats *before, MyGL_MeshCacheStats *after) {
+  auto it = mygl::namedModels.find(name);
+  if (it == mygl::namedModels.end()) {
+    utils::logout("%s - warning: couldn't find model archive '%s'", __func__, name);
+    return GL_FALSE;
+  }
+  // loaded as is, both sides are the file's order
+  auto model = it->second;
+  if (!model->statsValid && model->meshIbo && model->meshVbo) {
+    model->statsBefore = model->statsAfter = mygl::meshopt::analyze(model->meshIbo->dataPtr.uint32s, model->meshIbo->count, model->meshVbo->count);
+    model->statsValid = true;
+  }
+  if (before)
+    *before = MyGL_MeshCacheStats { .acmr = model->statsBefore.acmr, .atvr = model->statsBefore.atvr };
+  if (after)
+    *after = MyGL_MeshCacheStats { .acmr = model->statsAfter.acmr, .atvr = model->statsAfter.atvr };
+  return GL_TRUE;
+}
+
 void MyGL_drawModelArchive(const char *name) {
 
   extern MyGL myGL;
@@ -284,6 +694,8 @@ void MyGL_drawModelArchive(const char *name) {
   // NOTE: not our job to save/restore previous bound objects
   model->meshVbo->bind();
   model->meshIbo->bind();
+  mygl::modelMeshOffset = model->quantized ? model->boundsMin : MyGL_Vec3 { 0.0f, 0.0f, 0.0f };
+  mygl::modelMeshScale = model->quantized ? model->boundsScale : MyGL_Vec3 { 1.0f, 1.0f, 1.0f };
 
   for (uint32_t i = 0; i < material.numPasses(); i++) {
     material.apply(i);
@@ -2,6 +2,8 @@
 
 #include "public/mygl.h"
 #include "bufferobjs.h"
+#include "meshopt.h"
+#include "utils/thirdparty/miniz/miniz.h"
 #include <string>
 #include <vector>
 #include <memory>
@@ -33,14 +35,37 @@ struct Model {
   std::shared_ptr<Ibo> meshIbo;
   std::vector<std::string> textureNames;
   std::vector<std::shared_ptr<Tbo>> frameTbos;
+  MyGL_ModelOptions options = { };
+  std::vector<uint32_t> vertexRemap;  // where each vertex of the archive's order ended up, empty while unchanged
+  meshopt::CacheStats statsBefore = { }, statsAfter = { };
+  bool statsValid = false;  // only measured at load when something was optimized, otherwise on request
+  bool quantized = false;  // mesh vbo holds the 16 byte layout, positions are boundsMin + q / 65535 * boundsScale
+  MyGL_Vec3 boundsMin = { }, boundsScale = { };
 
-  void loadMesh(const char *meshFileData, uint32_t meshFileSize);
+  void createMeshBuffers(uint32_t vCount, uint32_t iCount, const std::vector<MyGL_VertexAttrib> &attribs);
+  // drops a mesh that failed to load
+  void releaseMeshBuffers();
+  // false (and no buffers) when a face refers past the vertices
+  bool loadMesh(const char *meshFileData, uint32_t meshFileSize);
+  bool loadMeshBinary(mz_zip_archive *zip, uint32_t fileIndex, size_t size, const char *source);
+  // runs the optimizations in options and uploads the mesh
+  void finishMesh();
+  // swaps the float vbo for the quantized one, false (and nothing changed) for other layouts
+  bool quantizeMesh();
+  // position and normal of a mesh vertex in either layout
+  FrameVertex restVertex(size_t i) const;
 //  void loadFrames(const char *framesFileData, uint32_t framesFileSize);
-  void loadFrame(const char *framesFileData, uint32_t framesFileSize, uint32_t frameNo);
+  std::shared_ptr<Tbo> createFrameTbo(uint32_t frameNo);
+  // only touches the tbo's shadow memory and parses on the calling thread, safe on a worker
+  void parseFrame(const char *framesFileData, uint32_t framesFileSize, Tbo &tbo) const;
   bool loadZipped(void *zipContent, uint32_t size, std::string_view name);
 
 };
 
 extern std::map<std::string, std::shared_ptr<Model>> namedModels;
+
+// 'mygl.meshOffset'/'mygl.meshScale', set for the model being drawn (zero and one for float meshes)
+extern MyGL_Vec3 modelMeshOffset, modelMeshScale;
+extern const char *quantizedVertexLibrary;
 }
 
@@ -3,6 +3,7 @@
 #include "colors.h"
 #include "model.h"
 #include "framebuffer.h"
+#include "vtexture.h"
 
 const MyGL_ColorFormat& mygl::colorFormatByName(const char *name) {
   auto it = mygl::colorFormatByNames.find(name);
@@ -17,3 +18,4 @@ std::map<std::string, std::shared_ptr<mygl::Texture<2> > > mygl::named2DTextures
 std::map<std::string, std::shared_ptr<mygl::Texture<3> > > mygl::named3DTextures;
 std::map<std::string, std::shared_ptr<mygl::Model>> mygl::namedModels;
 std::map<std::string, std::shared_ptr<mygl::FrameBuffer>> mygl::namedFrameBuffers;
+std::map<std::string, std::shared_ptr<mygl::VirtualTexture>> mygl::namedVirtualTextures;
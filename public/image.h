@@ -37,9 +37,43 @@ typedef struct MyGL_ROImage_s {
   const MyGL_Color *pixels;
 } MyGL_ROImage;
 
+typedef enum MyGL_PixelType_e {
+  MYGL_PIXEL_R8 = 0,
+  MYGL_PIXEL_RG8,
+  MYGL_PIXEL_R16F,
+  MYGL_PIXEL_RGBA16F,
+} MyGL_PixelType;
+
+// tightly packed texels in red, green, blue, alpha order (half floats for the 16F types), rows bottom-up like MyGL_Image
+typedef struct MyGL_TypedImage_s {
+  uint32_t w, h;
+  MyGL_PixelType type;
+  void *pixels;
+} MyGL_TypedImage;
+
+typedef enum MyGL_ImageFilter_e {
+  MYGL_FILTER_BOX = 0,
+  MYGL_FILTER_KAISER,
+  MYGL_FILTER_LANCZOS3,
+  MYGL_FILTER_BILINEAR,
+  MYGL_FILTER_MITCHELL,
+} MyGL_ImageFilter;
+
+// zero-initialized options give the plain box filter on the raw bytes
+typedef struct MyGL_MipOptions_s {
+  MyGL_ImageFilter filter;
+  uint8_t srgb;  // color channels are sRGB encoded, filter them in linear space (alpha is always linear)
+  uint32_t threads;  // 0 = all cores
+  uint8_t borrowLevel0;  // level 0 points at the source pixels instead of a copy, they must outlive the chain
+} MyGL_MipOptions;
+
+// all levels share one allocation (arena), level 0 excluded when borrowed
 typedef struct MyGL_MipChain_s {
   size_t count;
   MyGL_Image levels[24];
+  MyGL_Color *arena;
+  size_t arenaSize;  // in pixels
+  uint8_t borrowed;
 } MyGL_MipChain;
 
 #ifdef __cplusplus
@@ -54,12 +88,33 @@ DLLEXPORT void MyGL_imageFree(MyGL_Image *image);
 DLLEXPORT MyGL_Image MyGL_imageAlloc(uint32_t w, uint32_t h);
 DLLEXPORT MyGL_Image MyGL_imageFromBMPData(const void *data, uint32_t size, const char *source);
 DLLEXPORT MyGL_Image MyGL_imageFromPNGData(const void *data, uint32_t size, const char *source);
+// decodes count files concurrently (threads = 0 uses all cores), a failed entry is left empty; returns the number decoded
+DLLEXPORT uint32_t MyGL_imagesFromPNGDataBatch(const void *const *data, const uint32_t *sizes, const char *const *sources, uint32_t count, MyGL_Image *images, uint32_t threads);
+DLLEXPORT int MyGL_imagePNGInfo(const void *data, uint32_t size, uint32_t *w, uint32_t *h);
+// decodes straight into caller memory (e.g. a mip chain's level 0 or a mapped PBO), dest must match the PNG's size
+DLLEXPORT int MyGL_imageDecodePNGInto(const void *data, uint32_t size, const char *source, MyGL_Image dest);
 DLLEXPORT MyGL_Image MyGL_imageDup(MyGL_ROImage image);
 DLLEXPORT MyGL_Color MyGL_imageSampleBox(MyGL_ROImage image, uint32_t x, uint32_t y, uint32_t w, uint32_t h);
 DLLEXPORT MyGL_Image MyGL_imageMip(MyGL_ROImage image);
+// separable resample to any size, runs on all cores for large outputs
+DLLEXPORT MyGL_Image MyGL_imageResize(MyGL_ROImage image, uint32_t w, uint32_t h, MyGL_ImageFilter filter);
+
+DLLEXPORT uint32_t MyGL_pixelTypeSize(MyGL_PixelType type);
+DLLEXPORT void MyGL_typedImageFree(MyGL_TypedImage *image);
+DLLEXPORT MyGL_TypedImage MyGL_typedImageAlloc(uint32_t w, uint32_t h, MyGL_PixelType type);
+// keeps the leading channels of a 32 bit image, the 16F types get them normalized to [0, 1]
+DLLEXPORT MyGL_TypedImage MyGL_typedImageFromImage(MyGL_ROImage image, MyGL_PixelType type);
+// decodes without going through 32 bit pixels, 16 bit PNGs keep their precision in the 16F types
+DLLEXPORT MyGL_TypedImage MyGL_typedImageFromPNGData(const void *data, uint32_t size, const char *source, MyGL_PixelType type);
+// 2x2 box filter like MyGL_imageMip, empty once the image is 1x1
+DLLEXPORT MyGL_TypedImage MyGL_typedImageMip(MyGL_TypedImage image);
 
 DLLEXPORT void MyGL_mipChainFree(MyGL_MipChain *chain);
 DLLEXPORT MyGL_MipChain MyGL_mipChainCreate(MyGL_ROImage image);
+DLLEXPORT MyGL_MipChain MyGL_mipChainCreateParallel(MyGL_ROImage image, uint32_t threads);  // threads = 0 uses all cores
+DLLEXPORT MyGL_MipChain MyGL_mipChainCreateFiltered(MyGL_ROImage image, const MyGL_MipOptions *options);
+// rebuilds the chain for a new image, reusing its arena when the size matches
+DLLEXPORT void MyGL_mipChainUpdate(MyGL_MipChain *chain, MyGL_ROImage image, const MyGL_MipOptions *options);
 
 #ifdef __cplusplus
 }/* extern "C" */
@@ -83,7 +83,9 @@ typedef enum MyGL_VertexAttribType_e {
   MYGL_VERTEX_USHORT = GL_UNSIGNED_SHORT,
   MYGL_VERTEX_FLOAT = GL_FLOAT,
   MYGL_VERTEX_INT = GL_INT,
-  MYGL_VERTEX_UINT = GL_UNSIGNED_INT
+  MYGL_VERTEX_UINT = GL_UNSIGNED_INT,
+  MYGL_VERTEX_HALF_FLOAT = GL_HALF_FLOAT,  // read as floats whether normalized or not
+  MYGL_VERTEX_INT_2_10_10_10_REV = GL_INT_2_10_10_10_REV  // x, y, z in 10 bits and w in 2, one 4 byte word; components must be MYGL_XYZW
 } MyGL_VertexAttribType;
 
 typedef enum MyGL_Components_e {
@@ -190,8 +192,34 @@ typedef struct MyGL_ColorFormat_s {
   GLubyte rgbaSize[4];
   GLuint depthBits;
   GLuint stencilBits;
+  GLuint blockBytes;  // bytes per 4x4 block for compressed formats, 0 otherwise
 } MyGL_ColorFormat;
 
+typedef struct MyGL_TextureOptions_s {
+  GLboolean filtered;
+  GLboolean mipmapped;
+  GLboolean repeat;
+  MyGL_MipOptions mipOptions;
+  uint64_t cacheKey;  // non-zero: cook the uploaded levels into the texture cache under this key
+  GLboolean progressive;  // streamed textures: stop after the mip tail until finer levels are requested
+  GLboolean immutable;  // glTexStorage2D, sized once; with no pixels the levels are left for MyGL_uploadTexture2D
+  GLboolean gpuMipmaps;  // upload level 0 only and build the rest with glGenerateMipmap (uncompressed formats)
+} MyGL_TextureOptions;
+
+// zero-initialized options load the mesh in the order the archive has it
+typedef struct MyGL_ModelOptions_s {
+  GLboolean optimizeVertexCache;  // reorder triangles for the post-transform cache
+  GLboolean optimizeOverdraw;  // then draw outward-facing clusters of them first (positions must be float xyz in attribute 0)
+  GLboolean optimizeVertexFetch;  // renumber vertices by first use, frames are remapped to match
+  GLboolean quantize;  // 16 byte vertices: positions as normalized ushort4 over the mesh bounds, octahedral normals
+                       // in a normalized 2_10_10_10 word (xy) and half float uvs, decoded with "quantized.glsl"
+} MyGL_ModelOptions;
+
+typedef struct MyGL_MeshCacheStats_s {
+  float acmr;  // vertex shader runs per triangle (16 entry FIFO)
+  float atvr;  // vertex shader runs per vertex, 1.0 is ideal
+} MyGL_MeshCacheStats;
+
 typedef struct MyGL_Cull_s {
   GLboolean on;
   GLboolean frontIsCCW;
@@ -370,6 +398,13 @@ typedef enum MyGL_ReadWriteType_e {
   MYGL_READWRITE_UINT_248 = GL_UNSIGNED_INT_24_8,
 } MyGL_ReadWriteType;
 
+typedef enum MyGL_CaptureFormat_e {
+  MYGL_CAPTURE_BMP,  // 32 bit, written as read back
+  MYGL_CAPTURE_PNG,  // 8 bit RGB, fastest deflate level, row bands compressed in parallel
+} MyGL_CaptureFormat;
+
+typedef void (*MyGL_CaptureFunc)(void *user, const char *path, GLboolean ok);
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -397,17 +432,60 @@ DLLEXPORT void MyGL_bindSampler(uint32_t index);
 typedef char (*MyGl_GetCharFunc)(void*);
 
 DLLEXPORT void MyGL_readPixels(int x, int y, uint32_t w, uint32_t h, MyGL_ReadFormat format, MyGL_ReadWriteType type, void *pixels);
+// reads a rectangle of the current read framebuffer into a PBO without waiting on the GPU, the file is encoded and written on worker threads
+// done (may be null) is called from MyGL_pumpCaptures once the file is written or has failed
+DLLEXPORT GLboolean MyGL_captureToFile(int x, int y, uint32_t w, uint32_t h, MyGL_CaptureFormat format, const char *path, MyGL_CaptureFunc done, void *user);
+// once per frame, returns the number of captures still being read back or written
+DLLEXPORT uint32_t MyGL_pumpCaptures();
 DLLEXPORT GLboolean MyGL_loadShaderLibrary(MyGl_GetCharFunc source_feed, void *source_param, const char *alias);
 DLLEXPORT GLboolean MyGL_loadShaderLibraryStr(const char *source_str, const char *alias);
 DLLEXPORT GLboolean MyGL_loadShader(MyGl_GetCharFunc source_feed, void *source_param, const char *alias);
 DLLEXPORT GLboolean MyGL_loadShaderStr(const char *source_str, const char *alias);
 
 DLLEXPORT GLboolean MyGL_createTexture2D(const char *name, MyGL_ROImage image, const char *format, GLboolean filtered, GLboolean mipmapped, GLboolean repeat);
+DLLEXPORT GLboolean MyGL_createTexture2DEx(const char *name, MyGL_ROImage image, const char *format, const MyGL_TextureOptions *options);
+// uploads the texels as they are (GL_RED/GL_RG/GL_RGBA, bytes or half floats), format should match, e.g. "r8" for MYGL_PIXEL_R8
+// mips come from MyGL_typedImageMip (or the GPU with gpuMipmaps), cacheKey is ignored and compressed formats are rejected
+DLLEXPORT GLboolean MyGL_createTexture2DTyped(const char *name, MyGL_TypedImage image, const char *format, const MyGL_TextureOptions *options);
+DLLEXPORT void MyGL_setTextureCacheDir(const char *dir);
+DLLEXPORT uint64_t MyGL_textureCacheKey(const void *data, uint32_t size);
+DLLEXPORT GLboolean MyGL_createTexture2DFromCache(const char *name, uint64_t key, const char *format, const MyGL_TextureOptions *options);
+// decodes (png/bmp) and builds mips on worker threads, the texture is a 1x1 placeholder until it is resident
+DLLEXPORT GLboolean MyGL_streamTexture2D(const char *name, const void *data, uint32_t size, const char *format, const MyGL_TextureOptions *options);
+DLLEXPORT void MyGL_setTextureStreamBudget(uint32_t bytes_per_frame);  // 0 restores the default (4MB)
+// call once per frame, returns the number of textures still streaming
+DLLEXPORT uint32_t MyGL_pumpTextureStreams();
+// progressive streams only go finer than their tail once asked, requests never lower what was already asked for
+DLLEXPORT void MyGL_requestTextureLevel(const char *name, uint32_t level);  // e.g. the level a feedback pass saw sampled
+DLLEXPORT void MyGL_requestTextureScreenSize(const char *name, uint32_t screen_pixels);  // estimated size of the larger side on screen
+DLLEXPORT void MyGL_setTextureBudget(uint64_t bytes);  // 0 = unlimited
+// call once per frame after drawing: evicts the least recently bound textures that can be reloaded until the rest fit the budget, returns the bytes still resident
+DLLEXPORT uint64_t MyGL_trimTextures();
+// fills a tile of the given mip level whose top-left texel is (x, y) (negative or past the edge at the borders), called from worker threads
+typedef void (*MyGL_VirtualTileFunc)(void *user, uint32_t level, int32_t x, int32_t y, MyGL_Image tile);
+// w and h must be powers of two of at least 128, creates '<name>/physical' and '<name>/pages' for sampling through "virtualtexture.glsl"
+DLLEXPORT GLboolean MyGL_createVirtualTexture(const char *name, uint32_t w, uint32_t h, const char *format, uint32_t cache_pages, MyGL_VirtualTileFunc tile_func, void *user);
+DLLEXPORT GLboolean MyGL_createVirtualTextureFromImage(const char *name, MyGL_ROImage image, const char *format, uint32_t cache_pages);
+// rgba_pixels: the feedback target read back as GL_RGBA / GL_UNSIGNED_BYTE
+DLLEXPORT void MyGL_virtualTextureFeedback(const char *name, const void *rgba_pixels, uint32_t count);
+// once per frame, uploads up to max_uploads tiles (0 = all finished ones), returns the number of tiles still being produced
+DLLEXPORT uint32_t MyGL_updateVirtualTexture(const char *name, uint32_t max_uploads);
 DLLEXPORT GLboolean MyGL_createEmptyTexture2D(const char *name, uint32_t w, uint32_t h, const char *format, GLboolean filtered, GLboolean repeat);
+// DDS (DX10 or DXT1/DXT5/32 bit legacy) or KTX2, told apart by their magic: mips, array layers and BC1/BC3/BC7 payloads go to GL as stored,
+// rows stay top-down as the file has them; one layer makes a 2D texture, more a 2D texture array (the mip count comes from the file)
+// cube maps, volumes and supercompressed KTX2 are rejected
+DLLEXPORT GLboolean MyGL_createTextureFromContainer(const char *name, const void *data, uint32_t size, const MyGL_TextureOptions *options);
+// maps the file instead of reading it, evicted 2D textures are reloaded from it
+DLLEXPORT GLboolean MyGL_createTextureFromContainerFile(const char *name, const char *path, const MyGL_TextureOptions *options);
+// pixels are copied into a persistent-mapped unpack ring, the call does not wait for the GPU
 DLLEXPORT GLboolean MyGL_uploadTexture2D(const char *name, MyGL_WriteFormat format, MyGL_ReadWriteType type, uint32_t w, uint32_t h, void *pixels);
 
 DLLEXPORT GLboolean MyGL_createTexture2DArray(const char *name, MyGL_ROImage image_atlas, uint32_t num_rows, uint32_t num_cols, const char *format, GLboolean filtered, GLboolean mipmapped,
                                               GLboolean repeat);
+DLLEXPORT GLboolean MyGL_createTexture2DArrayEx(const char *name, MyGL_ROImage image_atlas, uint32_t num_rows, uint32_t num_cols, const char *format, const MyGL_TextureOptions *options);
+// rebuilds the mips of a 2D texture or array from level 0 on the GPU, e.g. after rendering into it
+// a texture created without mips (MyGL_createEmptyTexture2D) gets a full chain the first time
+DLLEXPORT GLboolean MyGL_generateMipmaps(const char *name);
 
 DLLEXPORT void MyGL_clear(GLboolean color, GLboolean depth, GLboolean stencil);
 
@@ -429,8 +507,13 @@ DLLEXPORT void MyGL_drawVbo(const char *name, MyGL_Primitive primitive, GLint st
 DLLEXPORT void MyGL_drawIndexedVbo(const char *vbo_name, const char *ibo_name, MyGL_Primitive primitive, GLuint count);
 
 DLLEXPORT GLboolean MyGL_loadModelArchive(const char *name, void *data, uint32_t size);
+DLLEXPORT GLboolean MyGL_loadModelArchiveEx(const char *name, void *data, uint32_t size, const MyGL_ModelOptions *options);
+// the mesh's cache efficiency as loaded and after the optimizations asked for (either may be null)
+DLLEXPORT GLboolean MyGL_modelArchiveCacheStats(const char *name, MyGL_MeshCacheStats *before, MyGL_MeshCacheStats *after);
 DLLEXPORT void MyGL_setModelArchiveTextures(const char *name, uint32_t skin_no, uint32_t skin_sampler, uint32_t *frame_samplers);
 DLLEXPORT void MyGL_drawModelArchive(const char *name);
+// writes the loaded mesh as a binary chunk, add it to the archive as 'mesh.bin' and it is loaded without parsing
+DLLEXPORT GLboolean MyGL_saveModelArchiveMesh(const char *name, const char *path);
 
 DLLEXPORT GLboolean MyGL_createFbo(const char *name, uint32_t w, uint32_t h);
 DLLEXPORT GLboolean MyGL_fboAttachColor(const char *name, const char *texture_name);
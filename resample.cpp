@@ -0,0 +1,281 @@
+#include "utils/threads.h"
+
+#include "resample.h"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define MYGL_RESAMPLE_SSE
+#endif
+
+namespace mygl {
+
+namespace resample {
+
+namespace {
+
+struct Tables {
+  float toLinear[256];
+  uint8_t toSrgb[16384];  // indexed by linear * 16383
+  Tables() {
+    for (int i = 0; i < 256; i++) {
+      float c = (float) i / 255.0f;
+      toLinear[i] = c <= 0.04045f ? c / 12.92f : powf((c + 0.055f) / 1.055f, 2.4f);
+    }
+    for (int i = 0; i < 16384; i++) {
+      float l = (float) i / 16383.0f;
+      float s = l <= 0.0031308f ? l * 12.92f : 1.055f * powf(l, 1.0f / 2.4f) - 0.055f;
+      toSrgb[i] = (uint8_t) (s * 255.0f + 0.5f);
+    }
+  }
+};
+
+const Tables& tables() {
+  static Tables t;
+  return t;
+}
+
+float sinc(float x) {
+  x = fabsf(x);
+  if (x < 1e-5f)
+    return 1.0f;
+  x *= 3.14159265f;
+  return sinf(x) / x;
+}
+
+float bessel0(float x) {
+  float sum = 1.0f, term = 1.0f;
+  for (int k = 1; k < 32; k++) {
+    term *= (x * 0.5f / k) * (x * 0.5f / k);
+    sum += term;
+    if (term < sum * 1e-7f)
+      break;
+  }
+  return sum;
+}
+
+struct Kernel {
+  float support;
+  float (*eval)(float);
+};
+
+Kernel kernelFor(MyGL_ImageFilter filter) {
+  switch (filter) {
+    case MYGL_FILTER_KAISER:
+      return Kernel { 3.0f, [](float x) {
+        const float alpha = 4.0f;
+        float t = x / 3.0f;
+        if (t <= -1.0f || t >= 1.0f)
+          return 0.0f;
+        return sinc(x) * bessel0(alpha * sqrtf(1.0f - t * t)) / bessel0(alpha);
+      } };
+    case MYGL_FILTER_LANCZOS3:
+      return Kernel { 3.0f, [](float x) {
+        return fabsf(x) < 3.0f ? sinc(x) * sinc(x / 3.0f) : 0.0f;
+      } };
+    case MYGL_FILTER_BILINEAR:
+      return Kernel { 1.0f, [](float x) {
+        return std::max(0.0f, 1.0f - fabsf(x));
+      } };
+    case MYGL_FILTER_MITCHELL:
+      // B = C = 1/3
+      return Kernel { 2.0f, [](float x) {
+        const float b = 1.0f / 3.0f, c = 1.0f / 3.0f;
+        x = fabsf(x);
+        if (x < 1.0f)
+          return ((12.0f - 9.0f * b - 6.0f * c) * x * x * x + (-18.0f + 12.0f * b + 6.0f * c) * x * x + (6.0f - 2.0f * b)) / 6.0f;
+        if (x < 2.0f)
+          return ((-b - 6.0f * c) * x * x * x + (6.0f * b + 30.0f * c) * x * x + (-12.0f * b - 48.0f * c) * x + (8.0f * b + 24.0f * c)) / 6.0f;
+        return 0.0f;
+      } };
+    case MYGL_FILTER_BOX:
+    default:
+      return Kernel { 0.5f, [](float x) {
+        return fabsf(x) <= 0.5f ? 1.0f : 0.0f;
+      } };
+  }
+}
+
+// per output sample: the source indices (edge clamped) and normalized weights it reads
+struct Taps {
+  uint32_t maxTaps = 0;
+  std::vector<uint32_t> count;
+  std::vector<uint32_t> indices;
+  std::vector<float> weights;
+
+  Taps(uint32_t srcSize, uint32_t dstSize, const Kernel &kernel) {
+    float scale = (float) srcSize / (float) dstSize;
+    float stretch = scale > 1.0f ? scale : 1.0f;
+    float radius = kernel.support * stretch;
+    maxTaps = (uint32_t) (radius * 2.0f) + 3;
+    count.resize(dstSize);
+    indices.resize((size_t) dstSize * maxTaps);
+    weights.resize((size_t) dstSize * maxTaps);
+
+    for (uint32_t i = 0; i < dstSize; i++) {
+      float center = ((float) i + 0.5f) * scale;
+      int32_t lo = (int32_t) floorf(center - radius);
+      int32_t hi = (int32_t) ceilf(center + radius);
+      uint32_t *idx = &indices[(size_t) i * maxTaps];
+      float *w = &weights[(size_t) i * maxTaps];
+      uint32_t n = 0;
+      float total = 0.0f;
+      for (int32_t j = lo; j <= hi && n < maxTaps; j++) {
+        float v = kernel.eval(((float) j + 0.5f - center) / stretch);
+        if (v == 0.0f)
+          continue;
+        idx[n] = (uint32_t) std::clamp(j, 0, (int32_t) srcSize - 1);
+        w[n] = v;
+        total += v;
+        n++;
+      }
+      if (!n || total == 0.0f) {
+        idx[0] = std::min((uint32_t) center, srcSize - 1);
+        w[0] = total = 1.0f;
+        n = 1;
+      }
+      for (uint32_t k = 0; k < n; k++)
+        w[k] /= total;
+      count[i] = n;
+    }
+  }
+};
+
+void decodeRow(const MyGL_Color *in, float *out, uint32_t w, bool srgb) {
+  const float *lut = tables().toLinear;
+  for (uint32_t x = 0; x < w; x++, out += 4) {
+    const MyGL_Color &c = in[x];
+    if (srgb) {
+      out[0] = lut[c.rgba[0]];
+      out[1] = lut[c.rgba[1]];
+      out[2] = lut[c.rgba[2]];
+    } else {
+      out[0] = c.rgba[0] * (1.0f / 255.0f);
+      out[1] = c.rgba[1] * (1.0f / 255.0f);
+      out[2] = c.rgba[2] * (1.0f / 255.0f);
+    }
+    out[3] = c.rgba[3] * (1.0f / 255.0f);
+  }
+}
+
+void encodeRow(const float *in, MyGL_Color *out, uint32_t w, bool srgb) {
+  const uint8_t *lut = tables().toSrgb;
+  for (uint32_t x = 0; x < w; x++, in += 4) {
+    float v[4];
+    for (int i = 0; i < 4; i++)
+      v[i] = in[i] < 0.0f ? 0.0f : in[i] > 1.0f ? 1.0f : in[i];
+    if (srgb) {
+      out[x].rgba[0] = lut[(int) (v[0] * 16383.0f + 0.5f)];
+      out[x].rgba[1] = lut[(int) (v[1] * 16383.0f + 0.5f)];
+      out[x].rgba[2] = lut[(int) (v[2] * 16383.0f + 0.5f)];
+    } else {
+      out[x].rgba[0] = (uint8_t) (v[0] * 255.0f + 0.5f);
+      out[x].rgba[1] = (uint8_t) (v[1] * 255.0f + 0.5f);
+      out[x].rgba[2] = (uint8_t) (v[2] * 255.0f + 0.5f);
+    }
+    out[x].rgba[3] = (uint8_t) (v[3] * 255.0f + 0.5f);
+  }
+}
+
+// out[x] = sum of weights * in[indices], one pixel (4 floats) at a time
+void filterRow(const float *in, float *out, const Taps &taps, uint32_t w) {
+  for (uint32_t x = 0; x < w; x++, out += 4) {
+    const uint32_t *idx = &taps.indices[(size_t) x * taps.maxTaps];
+    const float *wt = &taps.weights[(size_t) x * taps.maxTaps];
+#ifdef MYGL_RESAMPLE_SSE
+    __m128 acc = _mm_setzero_ps();
+    for (uint32_t k = 0; k < taps.count[x]; k++)
+      acc = _mm_add_ps(acc, _mm_mul_ps(_mm_loadu_ps(&in[idx[k] * 4]), _mm_set1_ps(wt[k])));
+    _mm_storeu_ps(out, acc);
+#else
+    float acc[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+    for (uint32_t k = 0; k < taps.count[x]; k++)
+      for (int i = 0; i < 4; i++)
+        acc[i] += in[idx[k] * 4 + i] * wt[k];
+    for (int i = 0; i < 4; i++)
+      out[i] = acc[i];
+#endif
+  }
+}
+
+// acc += in * weight over n floats
+void accumulate(float *acc, const float *in, float weight, size_t n) {
+  size_t i = 0;
+#ifdef MYGL_RESAMPLE_SSE
+  __m128 w = _mm_set1_ps(weight);
+  for (; i + 4 <= n; i += 4)
+    _mm_storeu_ps(&acc[i], _mm_add_ps(_mm_loadu_ps(&acc[i]), _mm_mul_ps(_mm_loadu_ps(&in[i]), w)));
+#endif
+  for (; i < n; i++)
+    acc[i] += in[i] * weight;
+}
+
+void resizeRows(MyGL_ROImage src, MyGL_Image dst, const Taps &hTaps, const Taps &vTaps, bool srgb, uint32_t y0, uint32_t y1) {
+  // source rows touched by this band
+  uint32_t rmin = UINT32_MAX, rmax = 0;
+  for (uint32_t y = y0; y < y1; y++)
+    for (uint32_t k = 0; k < vTaps.count[y]; k++) {
+      rmin = std::min(rmin, vTaps.indices[(size_t) y * vTaps.maxTaps + k]);
+      rmax = std::max(rmax, vTaps.indices[(size_t) y * vTaps.maxTaps + k]);
+    }
+
+  size_t rowFloats = (size_t) dst.w * 4;
+  std::vector<float> line((size_t) src.w * 4);
+  std::vector<float> rows(rowFloats * (rmax - rmin + 1));
+  std::vector<float> acc(rowFloats);
+
+  for (uint32_t r = rmin; r <= rmax; r++) {
+    decodeRow(&src.pixels[(size_t) r * src.w], line.data(), src.w, srgb);
+    filterRow(line.data(), &rows[rowFloats * (r - rmin)], hTaps, dst.w);
+  }
+
+  for (uint32_t y = y0; y < y1; y++) {
+    std::fill(acc.begin(), acc.end(), 0.0f);
+    for (uint32_t k = 0; k < vTaps.count[y]; k++) {
+      uint32_t r = vTaps.indices[(size_t) y * vTaps.maxTaps + k];
+      accumulate(acc.data(), &rows[rowFloats * (r - rmin)], vTaps.weights[(size_t) y * vTaps.maxTaps + k], rowFloats);
+    }
+    encodeRow(acc.data(), &dst.pixels[(size_t) y * dst.w], dst.w, srgb);
+  }
+}
+
+}
+
+float srgbToLinear(uint8_t v) {
+  return tables().toLinear[v];
+}
+
+uint8_t linearToSrgb(float v) {
+  v = v < 0.0f ? 0.0f : v > 1.0f ? 1.0f : v;
+  return tables().toSrgb[(int) (v * 16383.0f + 0.5f)];
+}
+
+void resize(MyGL_ROImage src, MyGL_Image dst, MyGL_ImageFilter filter, bool srgb, uint32_t threads) {
+  if (!src.pixels || !dst.pixels || !src.w || !src.h || !dst.w || !dst.h)
+    return;
+
+  Kernel kernel = kernelFor(filter);
+  Taps hTaps(src.w, dst.w, kernel);
+  Taps vTaps(src.h, dst.h, kernel);
+
+  const uint32_t bandRows = 64;
+  if (1 == threads || (size_t) dst.w * dst.h < 256 * 256) {
+    for (uint32_t y = 0; y < dst.h; y += bandRows)
+      resizeRows(src, dst, hTaps, vTaps, srgb, y, std::min(y + bandRows, dst.h));
+    return;
+  }
+
+  utils::TaskGroup tasks(utils::sharedPool(), threads);
+  for (uint32_t y = 0; y < dst.h; y += bandRows)
+    tasks.enqueue([&, y]() {
+      resizeRows(src, dst, hTaps, vTaps, srgb, y, std::min(y + bandRows, dst.h));
+    });
+  tasks.wait();
+}
+
+}
+
+}
@@ -0,0 +1,17 @@
+#pragma once
+
+#include "public/image.h"
+
+namespace mygl {
+
+namespace resample {
+
+float srgbToLinear(uint8_t v);
+uint8_t linearToSrgb(float v);
+
+// separable resample of src into dst (dst.pixels must be allocated), color channels are filtered in linear space when srgb is set
+void resize(MyGL_ROImage src, MyGL_Image dst, MyGL_ImageFilter filter, bool srgb, uint32_t threads);
+
+}
+
+}
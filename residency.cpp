@@ -0,0 +1,97 @@
+#include "utils/log.h"
+
+#include "residency.h"
+#include "textures.h"
+
+#include <algorithm>
+#include <unordered_map>
+#include <vector>
+
+namespace mygl {
+
+namespace residency {
+
+namespace {
+
+struct Entry {
+  std::weak_ptr<Texture2D> tex;
+  Reload reload;
+  uint64_t lastBind = 0;
+  bool reloading = false;
+};
+
+std::unordered_map<Texture<2>*, Entry> entries;
+uint64_t frame = 1;
+size_t budget = 0;  // 0 = unlimited
+
+}
+
+void track(const std::shared_ptr<Texture2D> &tex, Reload reload) {
+  Entry &entry = entries[tex.get()];
+  entry.tex = tex;
+  entry.reload = reload;
+  entry.lastBind = frame;
+  entry.reloading = !tex->resident;
+}
+
+void touch(Texture<2> *tex) {
+  auto it = entries.find(tex);
+  if (it == entries.end())
+    return;
+  Entry &entry = it->second;
+  entry.lastBind = frame;
+  auto shared = entry.tex.lock();
+  if (!shared)
+    return;
+  if (shared->resident) {
+    entry.reloading = false;
+    return;
+  }
+  if (entry.reloading || !entry.reload)
+    return;
+  entry.reloading = true;
+  if (MyGL_Debug_getChatty())
+    utils::logout("%s - reloading texture '%s'", __func__, tex->name.c_str());
+  entry.reload(shared);
+}
+
+void setBudget(size_t bytes) {
+  budget = bytes;
+}
+
+size_t trim() {
+  size_t total = 0;
+  std::vector<std::pair<uint64_t, Texture2D*> > candidates;
+  for (auto it = entries.begin(); it != entries.end();) {
+    if (it->second.tex.expired()) {
+      it = entries.erase(it);
+      continue;
+    }
+    auto tex = it->second.tex.lock();
+    total += tex->footprint();
+    // anything bound this frame stays, it is about to be drawn with
+    if (tex->resident && it->second.reload && it->second.lastBind < frame)
+      candidates.push_back( { it->second.lastBind, tex.get() });
+    ++it;
+  }
+
+  if (budget && total > budget) {
+    std::sort(candidates.begin(), candidates.end());
+    for (auto &c : candidates) {
+      if (total <= budget)
+        break;
+      Texture2D *tex = c.second;
+      size_t bytes = tex->footprint();
+      tex->evict();
+      total -= bytes - tex->footprint();
+      if (MyGL_Debug_getChatty())
+        utils::logout("%s - evicted texture '%s' (%u KB)", __func__, tex->name.c_str(), (unsigned) (bytes / 1024));
+    }
+  }
+  frame++;
+  return total;
+}
+
+}
+
+}
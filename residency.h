@@ -0,0 +1,30 @@
+#pragma once
+
+#include <functional>
+#include <memory>
+
+namespace mygl {
+
+template<int N> struct Texture;
+struct Texture2D;
+
+// keeps named 2D textures inside a byte budget, least recently bound ones are swapped for a 1x1 stand-in
+namespace residency {
+
+// brings an evicted texture back (synchronously or by streaming it in)
+using Reload = std::function<void(const std::shared_ptr<Texture2D>&)>;
+
+// textures without a reload function count against the budget but are never evicted
+void track(const std::shared_ptr<Texture2D> &tex, Reload reload = nullptr);
+
+// bind time: stamps the texture with the current frame and starts a reload if it was evicted
+void touch(Texture<2> *tex);
+
+void setBudget(size_t bytes);
+
+// ends the frame, evicts until the tracked textures fit the budget and returns the bytes still resident
+size_t trim();
+
+}
+
+}
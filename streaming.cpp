@@ -0,0 +1,331 @@
+#include "utils/log.h"
+#include "utils/threads.h"
+
+#include "streaming.h"
+#include "textures.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <list>
+#include <vector>
+
+namespace mygl {
+
+namespace streaming {
+
+namespace {
+
+const size_t defaultBudget = 4 * 1024 * 1024;
+const size_t slotBytes = 1024 * 1024;
+const int numSlots = 4;
+const uint32_t tailSize = 64;  // levels this size and below make up the tail that is uploaded up front
+
+enum State {
+  Decoding,
+  Ready,
+  Failed,
+};
+
+// one level in its upload layout, rows are block rows for compressed formats
+struct StagedLevel {
+  uint32_t w, h;
+  const uint8_t *data;
+  size_t rowBytes;
+  uint32_t rows;
+};
+
+struct Job {
+  std::string name;
+  std::shared_ptr<const std::vector<uint8_t> > encoded;
+  MyGL_TextureOptions options;
+  std::weak_ptr<Texture2D> target;
+  std::atomic<int> state { Decoding };
+
+  // worker output, read by the GL thread once state is Ready
+  MyGL_Image image = { };
+  MyGL_MipChain chain = { };
+  std::vector<uint8_t> blocks;
+  std::vector<StagedLevel> levels;
+
+  size_t tail = 0;  // first level of the tail
+
+  // upload progress, levels go in coarsest first
+  GLuint tex = 0;
+  size_t resident = 0;  // finest level fully uploaded, levels.size() while none are
+  size_t allocated = 0;
+  uint32_t row = 0;
+  bool adopted = false;
+
+  // progressive streams stop past the tail until something asks for more, GL thread only
+  size_t demandLevel = SIZE_MAX;
+  uint32_t demandPixels = 0;
+
+  ~Job() {
+    MyGL_mipChainFree(&chain);
+    MyGL_imageFree(&image);
+  }
+};
+
+struct Slot {
+  GLuint pbo = 0;
+  GLsync fence = nullptr;
+};
+
+std::unique_ptr<utils::ThreadPool> workers;
+std::list<std::shared_ptr<Job> > jobs;
+Slot slots[numSlots];
+int nextSlot = 0;
+size_t budget = defaultBudget;
+
+bool isPng(const std::vector<uint8_t> &data) {
+  return data.size() >= 8 && data[0] == 0x89 && data[1] == 'P' && data[2] == 'N' && data[3] == 'G';
+}
+
+// worker side: decode, build the chain and lay the levels out the way they will be uploaded
+void decode(Job &job, const MyGL_ColorFormat &format) {
+  const std::vector<uint8_t> &encoded = *job.encoded;
+  job.image = isPng(encoded) ?
+      MyGL_imageFromPNGData(encoded.data(), encoded.size(), job.name.c_str()) : MyGL_imageFromBMPData(encoded.data(), encoded.size(), job.name.c_str());
+  job.encoded = nullptr;
+  if (!job.image.pixels) {
+    job.state.store(Failed, std::memory_order_release);
+    return;
+  }
+
+  // the pool already spreads textures over the cores, so each one is built on a single thread
+  MyGL_MipOptions mipOptions = job.options.mipOptions;
+  mipOptions.threads = 1;
+  mipOptions.borrowLevel0 = 1;
+  if (job.options.mipmapped) {
+    job.chain = MyGL_mipChainCreateFiltered(toRo(job.image), &mipOptions);
+  } else {
+    job.chain.count = 1;
+    job.chain.levels[0] = job.image;
+  }
+
+  bc::Format compressed = bc::formatFor(format.sizedFormat);
+  if (compressed != bc::Format::None) {
+    size_t total = 0;
+    for (size_t i = 0; i < job.chain.count; i++)
+      total += bc::encodedSize(compressed, job.chain.levels[i].w, job.chain.levels[i].h);
+    job.blocks.resize(total);
+    uint8_t *next = job.blocks.data();
+    for (size_t i = 0; i < job.chain.count; i++) {
+      const MyGL_Image &level = job.chain.levels[i];
+      bc::encode(compressed, toRo(level), next, 1);
+      uint32_t bw = (level.w + 3) / 4, bh = (level.h + 3) / 4;
+      job.levels.push_back(StagedLevel { .w = level.w, .h = level.h, .data = next, .rowBytes = bw * bc::blockBytes(compressed), .rows = bh });
+      next += bc::encodedSize(compressed, level.w, level.h);
+    }
+  } else {
+    for (size_t i = 0; i < job.chain.count; i++) {
+      const MyGL_Image &level = job.chain.levels[i];
+      job.levels.push_back(StagedLevel { .w = level.w, .h = level.h, .data = (const uint8_t*) level.pixels, .rowBytes = level.w * sizeof(MyGL_Color), .rows = level.h });
+    }
+  }
+  if (!job.options.mipmapped)
+    job.chain = { };  // level 0 is the image itself, freed separately
+
+  job.tail = job.levels.size() - 1;
+  while (job.tail && std::max(job.levels[job.tail - 1].w, job.levels[job.tail - 1].h) <= tailSize)
+    job.tail--;
+  job.resident = job.allocated = job.levels.size();
+  job.state.store(Ready, std::memory_order_release);
+}
+
+// next free PBO, nullptr if the oldest one is still being read by the GPU
+Slot* acquireSlot() {
+  Slot &slot = slots[nextSlot];
+  if (!slot.pbo) {
+    glGenBuffers(1, &slot.pbo);
+    glBindBuffer( GL_PIXEL_UNPACK_BUFFER, slot.pbo);
+    glBufferData( GL_PIXEL_UNPACK_BUFFER, slotBytes, nullptr, GL_STREAM_DRAW);
+    glBindBuffer( GL_PIXEL_UNPACK_BUFFER, 0);
+  }
+  if (slot.fence) {
+    if (glClientWaitSync(slot.fence, 0, 0) == GL_TIMEOUT_EXPIRED)
+      return nullptr;
+    glDeleteSync(slot.fence);
+    slot.fence = nullptr;
+  }
+  nextSlot = (nextSlot + 1) % numSlots;
+  return &slot;
+}
+
+// finest level the job should reach for now
+size_t wanted(const Job &job) {
+  if (!job.options.progressive)
+    return 0;
+  size_t fit = job.levels.size() - 1;
+  while (fit && std::max(job.levels[fit].w, job.levels[fit].h) < job.demandPixels)
+    fit--;
+  return std::min( { job.tail, job.demandLevel, fit });
+}
+
+// level storage is only defined once it is about to be filled, unsampled levels cost nothing
+void allocateLevel(Job &job, size_t l, const MyGL_ColorFormat &format) {
+  const StagedLevel &level = job.levels[l];
+  if (format.blockBytes)
+    glCompressedTexImage2D( GL_TEXTURE_2D, l, format.sizedFormat, level.w, level.h, 0, level.rowBytes * level.rows, nullptr);
+  else
+    glTexImage2D( GL_TEXTURE_2D, l, format.sizedFormat, level.w, level.h, 0, GL_BGRA, GL_UNSIGNED_BYTE, nullptr);
+  job.allocated = l;
+}
+
+// uploads as many rows as the budget and the ring allow, false once the frame is out of either
+bool uploadRows(Job &job, const MyGL_ColorFormat &format, size_t &spent) {
+  size_t l = job.resident - 1;
+  const StagedLevel &level = job.levels[l];
+  uint32_t rows = level.rows - job.row;
+  size_t left = spent < budget ? budget - spent : 0;
+  rows = std::min<uint32_t>(rows, std::max<size_t>(left / level.rowBytes, spent ? 0 : 1));  // always make progress
+  if (!rows)
+    return false;
+
+  const uint8_t *src = level.data + job.row * level.rowBytes;
+  const void *pixels = src;
+  Slot *slot = nullptr;
+  if (level.rowBytes <= slotBytes) {
+    slot = acquireSlot();
+    if (!slot)
+      return false;
+    rows = std::min<uint32_t>(rows, slotBytes / level.rowBytes);
+    glBindBuffer( GL_PIXEL_UNPACK_BUFFER, slot->pbo);
+    void *dst = glMapBufferRange( GL_PIXEL_UNPACK_BUFFER, 0, rows * level.rowBytes, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+    memcpy(dst, src, rows * level.rowBytes);
+    glUnmapBuffer( GL_PIXEL_UNPACK_BUFFER);
+    pixels = nullptr;
+  }
+
+  glBindTexture( GL_TEXTURE_2D, job.tex);
+  if (job.allocated > l)
+    allocateLevel(job, l, format);
+  if (format.blockBytes) {
+    uint32_t y = job.row * 4;
+    uint32_t h = std::min(rows * 4, level.h - y);
+    glCompressedTexSubImage2D( GL_TEXTURE_2D, l, 0, y, level.w, h, format.sizedFormat, rows * level.rowBytes, pixels);
+  } else {
+    glTexSubImage2D( GL_TEXTURE_2D, l, 0, job.row, level.w, rows, GL_BGRA, GL_UNSIGNED_BYTE, pixels);
+  }
+  if (slot) {
+    slot->fence = glFenceSync( GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    glBindBuffer( GL_PIXEL_UNPACK_BUFFER, 0);
+  }
+
+  spent += rows * level.rowBytes;
+  job.row += rows;
+  if (job.row == level.rows) {
+    job.row = 0;
+    job.resident = l;
+  }
+  return true;
+}
+
+// a level just landed, the texture goes live with its tail and then sharpens one level at a time
+void landed(Job &job, Texture2D &target) {
+  if (job.adopted) {
+    glBindTexture( GL_TEXTURE_2D, job.tex);
+    target.setBaseLevel(job.resident);
+  } else if (job.resident <= job.tail) {
+    target.adopt(job.tex, job.levels[0].w, job.levels[0].h, job.levels.size(), job.resident);
+    job.adopted = true;
+  }
+}
+
+Job* find(const Texture2D *target) {
+  if (target)
+    for (auto &job : jobs)
+      if (job->target.lock().get() == target)
+        return job.get();
+  return nullptr;
+}
+
+}
+
+void setBudget(size_t bytesPerFrame) {
+  budget = bytesPerFrame ? bytesPerFrame : defaultBudget;
+}
+
+void enqueue(const char *name, std::shared_ptr<const std::vector<uint8_t> > encoded, const MyGL_TextureOptions &options, std::shared_ptr<Texture2D> target) {
+  if (!workers)
+    workers = std::make_unique<utils::ThreadPool>();
+
+  auto job = std::make_shared<Job>();
+  job->name = name;
+  job->encoded = encoded;
+  job->options = options;
+  job->target = target;
+  jobs.push_back(job);
+  // a copy: the job only holds the target weakly, it may be replaced while the worker decodes
+  workers->enqueue([job, format = target->format]() {
+    decode(*job, format);
+  });
+}
+
+uint32_t pump() {
+  size_t spent = 0;
+  glActiveTexture( MYGL_TEXTURE_USAGE_UNIT);
+  for (auto it = jobs.begin(); it != jobs.end();) {
+    Job &job = **it;
+    int state = job.state.load(std::memory_order_acquire);
+    if (state == Decoding) {
+      ++it;
+      continue;
+    }
+
+    auto target = job.target.lock();
+    if (state == Failed || !target) {
+      if (state == Failed)
+        utils::logout("%s error: texture '%s' could not be decoded", __func__, job.name.c_str());
+      if (job.tex && !job.adopted)
+        glDeleteTextures(1, &job.tex);
+      it = jobs.erase(it);
+      continue;
+    }
+
+    if (job.adopted && target->tex != job.tex) {
+      it = jobs.erase(it);  // evicted, the storage went with it
+      continue;
+    }
+
+    if (!job.tex)
+      glGenTextures(1, &job.tex);
+    size_t finest = wanted(job);
+    while (job.resident > finest && uploadRows(job, target->format, spent))
+      if (!job.row)
+        landed(job, *target);
+    if (job.resident > finest)
+      break;  // out of budget (or PBOs) for this frame
+    if (job.resident) {
+      ++it;  // parked on its tail until demand asks for finer levels
+      continue;
+    }
+
+    if (MyGL_Debug_getChatty())
+      utils::logout("%s - texture '%s' is resident (%u x %u)", __func__, job.name.c_str(), job.levels[0].w, job.levels[0].h);
+    it = jobs.erase(it);
+  }
+  glBindTexture( GL_TEXTURE_2D, 0);
+
+  uint32_t busy = 0;
+  for (auto &job : jobs)
+    if (job->state.load(std::memory_order_acquire) != Ready || job->resident > wanted(*job))
+      busy++;
+  return busy;
+}
+
+void demandLevel(const Texture2D *target, uint32_t level) {
+  if (Job *job = find(target))
+    job->demandLevel = std::min<size_t>(job->demandLevel, level);
+}
+
+void demandSize(const Texture2D *target, uint32_t pixels) {
+  if (Job *job = find(target))
+    job->demandPixels = std::max(job->demandPixels, pixels);
+}
+
+}
+
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+#include "public/mygl.h"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace mygl {
+
+struct Texture2D;
+
+// decode and mip generation on worker threads, uploads through a PBO ring under a per-frame byte budget
+// levels go in coarsest first, the texture goes live as soon as its tail is in and GL_TEXTURE_BASE_LEVEL follows the uploads
+namespace streaming {
+
+void setBudget(size_t bytesPerFrame);
+
+// encoded is the png/bmp file, target is the placeholder that gets the finished storage
+void enqueue(const char *name, std::shared_ptr<const std::vector<uint8_t> > encoded, const MyGL_TextureOptions &options, std::shared_ptr<Texture2D> target);
+
+// GL thread only, returns the number of textures still in flight (parked progressive ones don't count)
+uint32_t pump();
+
+// progressive streams stop once their mip tail is in, these let finer levels through
+void demandLevel(const Texture2D *target, uint32_t level);
+void demandSize(const Texture2D *target, uint32_t pixels);  // larger side on screen
+
+}
+
+}
@@ -15,6 +15,7 @@ uint32_t sizeOfAttrib(MyGL_VertexAttribType t) {
       return 1;
     case (MYGL_VERTEX_SHORT):
     case (MYGL_VERTEX_USHORT):
+    case (MYGL_VERTEX_HALF_FLOAT):
       return 2;
     case (MYGL_VERTEX_INT):
     case (MYGL_VERTEX_UINT):
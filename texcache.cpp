@@ -0,0 +1,168 @@
+#include "utils/log.h"
+#include "utils/hash.h"
+
+#include "texcache.h"
+
+#include <cstdio>
+#include <filesystem>
+
+namespace mygl {
+
+namespace texcache {
+
+namespace {
+
+const char magic[4] = { 'M', 'G', 'L', 'T' };
+const uint32_t version = 1;
+
+struct FileHeader {
+  char magic[4];
+  uint32_t version;
+  int32_t sizedFormat;
+  uint32_t levelCount;
+};
+
+struct LevelHeader {
+  uint32_t w, h;
+  uint64_t offset, size;
+};
+
+std::string cacheDir;
+
+// what GL reads for a level: 4x4 blocks for compressed formats, BGRA texels otherwise
+uint64_t levelSize(const MyGL_ColorFormat &format, uint32_t w, uint32_t h) {
+  if (format.blockBytes)
+    return (uint64_t) ((w + 3) / 4) * ((h + 3) / 4) * format.blockBytes;
+  return (uint64_t) w * h * 4;
+}
+
+}
+
+void setDir(const char *dir) {
+  cacheDir = dir ? dir : "";
+  if (cacheDir.empty())
+    return;
+  std::error_code ec;
+  std::filesystem::create_directories(cacheDir, ec);
+  if (ec)
+    utils::logout("%s error: cannot create texture cache '%s'", __func__, dir);
+}
+
+std::string pathFor(uint64_t key, const MyGL_ColorFormat &format, const MyGL_TextureOptions &options) {
+  if (cacheDir.empty())
+    return "";
+  const uint64_t fields[] = { key, (uint64_t) format.sizedFormat, options.mipmapped, (uint64_t) options.mipOptions.filter, options.mipOptions.srgb, options.gpuMipmaps };
+  char name[32];
+  snprintf(name, sizeof(name), "%016llx.myglt", (unsigned long long) utils::hash64(fields, sizeof(fields)));
+  return (std::filesystem::path(cacheDir) / name).string();
+}
+
+bool load(const std::string &path, const MyGL_ColorFormat &format, Cooked &cooked) {
+  if (path.empty() || !cooked.file.open(path.c_str()))
+    return false;
+
+  const uint8_t *data = cooked.file.data();
+  size_t size = cooked.file.size();
+  FileHeader header;
+  if (size < sizeof(header))
+    return false;
+  memcpy(&header, data, sizeof(header));
+  if (memcmp(header.magic, magic, 4) || header.version != version || !header.levelCount || header.levelCount > 32) {
+    utils::logout("%s error: '%s' is not a cooked texture", __func__, path.c_str());
+    return false;
+  }
+  if (header.sizedFormat != format.sizedFormat) {
+    utils::logout("%s error: '%s' was cooked as format %x", __func__, path.c_str(), header.sizedFormat);
+    return false;
+  }
+  size_t tableEnd = sizeof(header) + header.levelCount * sizeof(LevelHeader);
+  if (size < tableEnd)
+    return false;
+
+  // the levels must halve down from level 0, no further than 1x1, and hold exactly what the upload will read
+  LevelHeader first;
+  memcpy(&first, data + sizeof(header), sizeof(first));
+  uint32_t chain = 1;
+  while ((first.w | first.h) >> chain)
+    chain++;
+  if (!first.w || !first.h || header.levelCount > chain) {
+    utils::logout("%s error: '%s' has %u level(s) for %ux%u texels", __func__, path.c_str(), header.levelCount, first.w, first.h);
+    return false;
+  }
+
+  cooked.levels.clear();
+  uint32_t w = first.w, h = first.h;
+  for (uint32_t i = 0; i < header.levelCount; i++) {
+    LevelHeader level;
+    memcpy(&level, data + sizeof(header) + i * sizeof(LevelHeader), sizeof(level));
+    if (level.w != w || level.h != h || level.size != levelSize(format, w, h)) {
+      utils::logout("%s error: '%s' has a bad level %u (%ux%u, %llu bytes)", __func__, path.c_str(), i, level.w, level.h, (unsigned long long) level.size);
+      return false;
+    }
+    if (level.offset < tableEnd || level.offset > size || level.size > size - level.offset) {
+      utils::logout("%s error: '%s' is truncated", __func__, path.c_str());
+      return false;
+    }
+    cooked.levels.push_back(Level { .w = level.w, .h = level.h, .data = data + level.offset, .size = (size_t) level.size });
+    w = w > 1 ? w / 2 : 1;
+    h = h > 1 ? h / 2 : 1;
+  }
+  return true;
+}
+
+bool store(const std::string &path, GLuint tex, const MyGL_ColorFormat &format, size_t numMips) {
+  if (path.empty() || !numMips)
+    return false;
+
+  std::vector<LevelHeader> table(numMips);
+  std::vector<uint8_t> payload;
+  uint64_t offset = sizeof(FileHeader) + numMips * sizeof(LevelHeader);
+
+  glActiveTexture( MYGL_TEXTURE_USAGE_UNIT);
+  glBindTexture( GL_TEXTURE_2D, tex);
+  for (size_t i = 0; i < numMips; i++) {
+    GLint w = 0, h = 0, size = 0;
+    glGetTexLevelParameteriv( GL_TEXTURE_2D, i, GL_TEXTURE_WIDTH, &w);
+    glGetTexLevelParameteriv( GL_TEXTURE_2D, i, GL_TEXTURE_HEIGHT, &h);
+    if (format.blockBytes)
+      glGetTexLevelParameteriv( GL_TEXTURE_2D, i, GL_TEXTURE_COMPRESSED_IMAGE_SIZE, &size);
+    else
+      size = w * h * 4;
+    table[i] = LevelHeader { .w = (uint32_t) w, .h = (uint32_t) h, .offset = offset + payload.size(), .size = (uint64_t) size };
+    payload.resize(payload.size() + size);
+    uint8_t *dst = payload.data() + payload.size() - size;
+    if (format.blockBytes)
+      glGetCompressedTexImage( GL_TEXTURE_2D, i, dst);
+    else
+      glGetTexImage( GL_TEXTURE_2D, i, GL_BGRA, GL_UNSIGNED_BYTE, dst);
+  }
+  glBindTexture( GL_TEXTURE_2D, 0);
+
+  // written next to the target and renamed over it, so a crash never leaves a half-written file behind
+  std::string temp = path + ".tmp";
+  FILE *fp = fopen(temp.c_str(), "wb");
+  if (!fp) {
+    utils::logout("%s error: cannot write '%s'", __func__, temp.c_str());
+    return false;
+  }
+  FileHeader header = { { }, version, format.sizedFormat, (uint32_t) numMips };
+  memcpy(header.magic, magic, 4);
+  bool ok = fwrite(&header, sizeof(header), 1, fp) == 1;
+  ok = ok && fwrite(table.data(), sizeof(LevelHeader), table.size(), fp) == table.size();
+  ok = ok && fwrite(payload.data(), 1, payload.size(), fp) == payload.size();
+  ok = !fclose(fp) && ok;
+
+  std::error_code ec;
+  if (ok)
+    std::filesystem::rename(temp, path, ec);
+  if (!ok || ec) {
+    std::filesystem::remove(temp, ec);
+    utils::logout("%s error: cannot write '%s'", __func__, path.c_str());
+    return false;
+  }
+  return true;
+}
+
+}
+
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+#include "utils/mapfile.h"
+#include "public/mygl.h"
+
+#include <string>
+#include <vector>
+
+namespace mygl {
+
+// cooked textures (.myglt): a header, a level table and every mip level in its final upload layout
+namespace texcache {
+
+struct Level {
+  uint32_t w, h;
+  const uint8_t *data;
+  size_t size;
+};
+
+// levels point into the mapped file and stay valid until it is closed
+struct Cooked {
+  utils::MappedFile file;
+  std::vector<Level> levels;
+};
+
+void setDir(const char *dir);
+
+// cache file for a source key under the formats/options that change the cooked bytes, empty if no cache dir is set
+std::string pathFor(uint64_t key, const MyGL_ColorFormat &format, const MyGL_TextureOptions &options);
+
+bool load(const std::string &path, const MyGL_ColorFormat &format, Cooked &cooked);
+
+// reads every level of a GL_TEXTURE_2D back and writes it out
+bool store(const std::string &path, GLuint tex, const MyGL_ColorFormat &format, size_t numMips);
+
+}
+
+}
@@ -0,0 +1,258 @@
+#include "utils/log.h"
+
+#include "texcontainer.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace mygl {
+
+namespace texcontainer {
+
+namespace {
+
+struct Mapping {
+  uint32_t id;  // DXGI_FORMAT or VkFormat
+  const char *format;
+  GLenum pixelFormat;
+  uint32_t bytes;  // per texel, per 4x4 block for block formats
+  bool block;
+};
+
+// @formatter:off
+const Mapping dxgiFormats[] = {
+    { 71, "bc1", 0, 8, true }, { 72, "bc1srgb", 0, 8, true },
+    { 77, "bc3", 0, 16, true }, { 78, "bc3srgb", 0, 16, true },
+    { 98, "bc7", 0, 16, true }, { 99, "bc7srgb", 0, 16, true },
+    { 28, "rgba8", GL_RGBA, 4, false }, { 29, "srgb8alpha8", GL_RGBA, 4, false },
+    { 87, "rgba8", GL_BGRA, 4, false }, { 91, "srgb8alpha8", GL_BGRA, 4, false },
+    { 49, "rg8", GL_RG, 2, false }, { 61, "r8", GL_RED, 1, false },
+};
+
+// bc1 with punch-through alpha loads as opaque bc1, colors.h has no rgba variant
+const Mapping vkFormats[] = {
+    { 131, "bc1", 0, 8, true }, { 132, "bc1srgb", 0, 8, true }, { 133, "bc1", 0, 8, true }, { 134, "bc1srgb", 0, 8, true },
+    { 137, "bc3", 0, 16, true }, { 138, "bc3srgb", 0, 16, true },
+    { 145, "bc7", 0, 16, true }, { 146, "bc7srgb", 0, 16, true },
+    { 37, "rgba8", GL_RGBA, 4, false }, { 43, "srgb8alpha8", GL_RGBA, 4, false },
+    { 44, "rgba8", GL_BGRA, 4, false }, { 50, "srgb8alpha8", GL_BGRA, 4, false },
+    { 16, "rg8", GL_RG, 2, false }, { 9, "r8", GL_RED, 1, false },
+};
+// @formatter:on
+
+template<size_t N>
+const Mapping* find(const Mapping (&table)[N], uint32_t id) {
+  for (const Mapping &m : table)
+    if (m.id == id)
+      return &m;
+  return nullptr;
+}
+
+uint64_t levelSize(const Mapping &m, uint32_t w, uint32_t h) {
+  if (m.block)
+    return (uint64_t) ((w + 3) / 4) * ((h + 3) / 4) * m.bytes;
+  return (uint64_t) w * h * m.bytes;
+}
+
+// a full chain down to 1x1, Texture2D::levelCount
+uint32_t maxLevels(uint32_t w, uint32_t h) {
+  uint32_t count = 1;
+  while ((w | h) >> count)
+    count++;
+  return count;
+}
+
+// header counts checked before anything is sized by them: at least one texel, no more levels than the chain
+// holds, and every layer's level 0 inside the payload
+bool validCounts(const Mapping &m, uint32_t w, uint32_t h, uint32_t levels, uint32_t layers, uint64_t payload, const char *func, const char *source) {
+  if (!w || !h || levels > maxLevels(w, h)) {
+    utils::logout("%s error: '%s' has %u level(s) for %ux%u texels", func, source, levels, w, h);
+    return false;
+  }
+  if (layers > payload / levelSize(m, w, h)) {
+    utils::logout("%s error: '%s' is truncated", func, source);
+    return false;
+  }
+  return true;
+}
+
+uint32_t fourCC(char a, char b, char c, char d) {
+  return (uint32_t) (uint8_t) a | (uint32_t) (uint8_t) b << 8 | (uint32_t) (uint8_t) c << 16 | (uint32_t) (uint8_t) d << 24;
+}
+
+#pragma pack(push, 1)
+
+struct DdsPixelFormat {
+  uint32_t size, flags, fourCC, rgbBitCount;
+  uint32_t rMask, gMask, bMask, aMask;
+};
+
+struct DdsHeader {
+  uint32_t size, flags, height, width, pitchOrLinearSize, depth, mipMapCount;
+  uint32_t reserved1[11];
+  DdsPixelFormat pixelFormat;
+  uint32_t caps, caps2, caps3, caps4, reserved2;
+};
+
+struct DdsHeaderDx10 {
+  uint32_t dxgiFormat, resourceDimension, miscFlag, arraySize, miscFlags2;
+};
+
+struct Ktx2Header {
+  uint8_t identifier[12];
+  uint32_t vkFormat, typeSize, pixelWidth, pixelHeight, pixelDepth, layerCount, faceCount, levelCount, supercompressionScheme;
+  uint32_t dfdByteOffset, dfdByteLength, kvdByteOffset, kvdByteLength;
+  uint64_t sgdByteOffset, sgdByteLength;
+};
+
+struct Ktx2Level {
+  uint64_t byteOffset, byteLength, uncompressedByteLength;
+};
+
+#pragma pack(pop)
+
+const uint8_t ktx2Identifier[12] = { 0xab, 'K', 'T', 'X', ' ', '2', '0', 0xbb, '\r', '\n', 0x1a, '\n' };
+
+// legacy headers without a DX10 block, only the layouts our tools write
+const Mapping* legacyDds(const DdsPixelFormat &pf) {
+  static const Mapping dxt1 = { 0, "bc1", 0, 8, true }, dxt5 = { 0, "bc3", 0, 16, true };
+  static const Mapping bgra = { 0, "rgba8", GL_BGRA, 4, false }, rgba = { 0, "rgba8", GL_RGBA, 4, false };
+  if (pf.flags & 0x4) {  // DDPF_FOURCC
+    if (pf.fourCC == fourCC('D', 'X', 'T', '1'))
+      return &dxt1;
+    if (pf.fourCC == fourCC('D', 'X', 'T', '5'))
+      return &dxt5;
+    return nullptr;
+  }
+  if (pf.rgbBitCount == 32 && pf.rMask == 0x00ff0000u && pf.gMask == 0x0000ff00u && pf.bMask == 0x000000ffu)
+    return &bgra;
+  if (pf.rgbBitCount == 32 && pf.rMask == 0x000000ffu && pf.gMask == 0x0000ff00u && pf.bMask == 0x00ff0000u)
+    return &rgba;
+  return nullptr;
+}
+
+bool parseDds(const uint8_t *data, size_t size, const char *source, Parsed &parsed) {
+  DdsHeader header;
+  if (size < 4 + sizeof(header)) {
+    utils::logout("%s error: '%s' is truncated", __func__, source);
+    return false;
+  }
+  memcpy(&header, data + 4, sizeof(header));
+  size_t offset = 4 + sizeof(header);
+
+  const Mapping *mapping = nullptr;
+  uint32_t layers = 1;
+  bool cube = header.caps2 & 0x200, volume = header.caps2 & 0x200000;
+  if ((header.pixelFormat.flags & 0x4) && header.pixelFormat.fourCC == fourCC('D', 'X', '1', '0')) {
+    DdsHeaderDx10 dx10;
+    if (size < offset + sizeof(dx10)) {
+      utils::logout("%s error: '%s' is truncated", __func__, source);
+      return false;
+    }
+    memcpy(&dx10, data + offset, sizeof(dx10));
+    offset += sizeof(dx10);
+    mapping = find(dxgiFormats, dx10.dxgiFormat);
+    layers = dx10.arraySize ? dx10.arraySize : 1;
+    cube = cube || (dx10.miscFlag & 0x4);
+    volume = volume || dx10.resourceDimension == 4;
+    if (!mapping)
+      utils::logout("%s error: '%s' has unsupported DXGI format %u", __func__, source, dx10.dxgiFormat);
+  } else {
+    mapping = legacyDds(header.pixelFormat);
+    if (!mapping)
+      utils::logout("%s error: '%s' has an unsupported legacy pixel format", __func__, source);
+  }
+  if (!mapping)
+    return false;
+  if (cube || volume) {
+    utils::logout("%s error: '%s' is a %s, only 2D textures and arrays are supported", __func__, source, cube ? "cube map" : "volume");
+    return false;
+  }
+
+  uint32_t levels = (header.flags & 0x20000) && header.mipMapCount ? header.mipMapCount : 1;  // DDSD_MIPMAPCOUNT
+  if (!validCounts(*mapping, header.width, header.height, levels, layers, size - offset, __func__, source))
+    return false;
+  parsed.format = mapping->format;
+  parsed.pixelFormat = mapping->pixelFormat;
+  parsed.layers.assign(layers, { });
+  // every layer carries its whole chain before the next one starts
+  for (uint32_t layer = 0; layer < layers; layer++) {
+    uint32_t w = header.width, h = header.height;
+    for (uint32_t i = 0; i < levels; i++) {
+      size_t bytes = (size_t) levelSize(*mapping, w, h);
+      if (size - offset < bytes) {
+        utils::logout("%s error: '%s' is truncated", __func__, source);
+        return false;
+      }
+      parsed.layers[layer].push_back(texcache::Level { .w = w, .h = h, .data = data + offset, .size = bytes });
+      offset += bytes;
+      w = w > 1 ? w / 2 : 1;
+      h = h > 1 ? h / 2 : 1;
+    }
+  }
+  return true;
+}
+
+bool parseKtx2(const uint8_t *data, size_t size, const char *source, Parsed &parsed) {
+  Ktx2Header header;
+  if (size < sizeof(header)) {
+    utils::logout("%s error: '%s' is truncated", __func__, source);
+    return false;
+  }
+  memcpy(&header, data, sizeof(header));
+  if (header.supercompressionScheme) {
+    utils::logout("%s error: '%s' is supercompressed (scheme %u)", __func__, source, header.supercompressionScheme);
+    return false;
+  }
+  if (header.faceCount > 1 || header.pixelDepth > 1) {
+    utils::logout("%s error: '%s' is a %s, only 2D textures and arrays are supported", __func__, source, header.faceCount > 1 ? "cube map" : "volume");
+    return false;
+  }
+  const Mapping *mapping = find(vkFormats, header.vkFormat);
+  if (!mapping) {
+    utils::logout("%s error: '%s' has unsupported VkFormat %u", __func__, source, header.vkFormat);
+    return false;
+  }
+
+  uint32_t levels = header.levelCount ? header.levelCount : 1;
+  uint32_t layers = header.layerCount ? header.layerCount : 1;
+  if (levels > 32 || size < sizeof(header) + levels * sizeof(Ktx2Level)) {
+    utils::logout("%s error: '%s' is truncated", __func__, source);
+    return false;
+  }
+  if (!validCounts(*mapping, header.pixelWidth, header.pixelHeight, levels, layers, size, __func__, source))
+    return false;
+  parsed.format = mapping->format;
+  parsed.pixelFormat = mapping->pixelFormat;
+  parsed.layers.assign(layers, { });
+  // a level holds all of its layers back to back
+  for (uint32_t i = 0; i < levels; i++) {
+    Ktx2Level level;
+    memcpy(&level, data + sizeof(header) + i * sizeof(Ktx2Level), sizeof(level));
+    uint32_t w = std::max(header.pixelWidth >> i, 1u), h = std::max(header.pixelHeight >> i, 1u);
+    uint64_t bytes = levelSize(*mapping, w, h);
+    // layers * bytes can't wrap: validCounts bounds it by the file size at level 0
+    if (level.byteOffset > size || level.byteLength > size - level.byteOffset || level.byteLength < bytes * layers) {
+      utils::logout("%s error: '%s' is truncated", __func__, source);
+      return false;
+    }
+    for (uint32_t layer = 0; layer < layers; layer++)
+      parsed.layers[layer].push_back(texcache::Level { .w = w, .h = h, .data = data + level.byteOffset + layer * bytes, .size = (size_t) bytes });
+  }
+  return true;
+}
+
+}
+
+bool parse(const uint8_t *data, size_t size, const char *source, Parsed &parsed) {
+  if (data && size >= 4 && !memcmp(data, "DDS ", 4))
+    return parseDds(data, size, source, parsed);
+  if (data && size >= sizeof(ktx2Identifier) && !memcmp(data, ktx2Identifier, sizeof(ktx2Identifier)))
+    return parseKtx2(data, size, source, parsed);
+  utils::logout("%s error: '%s' is neither DDS nor KTX2", __func__, source);
+  return false;
+}
+
+}
+
+}
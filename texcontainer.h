@@ -0,0 +1,24 @@
+#pragma once
+
+#include "texcache.h"
+
+#include <string>
+#include <vector>
+
+namespace mygl {
+
+// DDS and KTX2 files, parsed in place: the levels point into the caller's bytes in their upload layout
+namespace texcontainer {
+
+struct Parsed {
+  std::string format;  // colorFormatByNames key
+  GLenum pixelFormat;  // GL_BGRA, GL_RGBA, GL_RG or GL_RED, unused for block formats
+  std::vector<std::vector<texcache::Level> > layers;  // [layer][level]
+};
+
+// 2D textures and arrays only, false (logged) for cube maps, volumes, supercompression and formats without a GL mapping
+bool parse(const uint8_t *data, size_t size, const char *source, Parsed &parsed);
+
+}
+
+}
@@ -38,7 +38,12 @@ std::map<std::string, CharSet> textureCharSets;
 int MyGL_loadAsciiCharSet(const MyGL_AsciiCharSet *char_set, int filtered, int mipmapped) {
 
   MyGL_ROImage image = { .w = char_set->imageAtlas.w, .h = char_set->imageAtlas.h, .pixels = char_set->imageAtlas.pixels };
-  if (!MyGL_createTexture2D(char_set->name.chars, image, "r8", filtered, mipmapped, GL_FALSE)) {
+  // only red is sampled, narrow once here rather than have the driver convert every level
+  MyGL_TypedImage atlas = MyGL_typedImageFromImage(image, MYGL_PIXEL_R8);
+  MyGL_TextureOptions options = { .filtered = (GLboolean) filtered, .mipmapped = (GLboolean) mipmapped, .repeat = GL_FALSE, .mipOptions = { }, .cacheKey = 0, .progressive = GL_FALSE, .immutable = GL_FALSE, .gpuMipmaps = GL_FALSE };
+  GLboolean created = MyGL_createTexture2DTyped(char_set->name.chars, atlas, "r8", &options);
+  MyGL_typedImageFree(&atlas);
+  if (!created) {
     utils::logout("error: failed to load ascii character set '%s'", char_set->name.chars);
     return GL_FALSE;
   }
@@ -8,10 +8,14 @@
 #include <map>
 
 #include "utils/log.h"
+#include "utils/threads.h"
 #include "public/mygl.h"
 #include "bufferobjs.h"
 #include "colors.h"
 #include "image.h"
+#include "blockcompress.h"
+#include "texcache.h"
+#include "unpackring.h"
 
 /*
  Texture formats and Data formats are different!
@@ -82,19 +86,24 @@ struct Texture {
 
   Texture(const char *name_, GLenum target_, const char *format_, bool filtered_, bool mipmapped_, bool repeat_)
       :
+      name(name_),
       target(target_),
       format(colorFormatByName(format_)),
       filtered(filtered_),
       mipmapped(mipmapped_),
       repeat(repeat_) {
 
-    static float aniso = -1.0f;
-    if (aniso < 0.0f)
-      glGetFloatv( GL_MAX_TEXTURE_MAX_ANISOTROPY_EXT, &aniso);
-
     glActiveTexture( MYGL_TEXTURE_USAGE_UNIT);
     glGenTextures(1, &tex);
     glBindTexture(target, tex);
+    setParameters();
+  }
+
+  // sampling state for the currently bound texture
+  void setParameters() {
+    static float aniso = -1.0f;
+    if (aniso < 0.0f)
+      glGetFloatv( GL_MAX_TEXTURE_MAX_ANISOTROPY_EXT, &aniso);
 
     glTexParameteri(target, GL_TEXTURE_BASE_LEVEL, 0);
     if (!mipmapped)
@@ -192,6 +201,9 @@ struct Texture {
 
 struct Texture2D : public Texture<2> {
   size_t numMips = 0;
+  bool resident = true;  // false while streaming in or evicted
+  size_t baseLevel = 0;  // finest level with data, progressive streams lower it as levels land
+  bool immutable = false;  // storage sized once by glTexStorage2D, levels are filled in with sub-image uploads
   /*
    Texture2D( const char *name_, GLuint w, GLuint h, const char *format_, bool filtered_, bool mipmapped_, bool repeat_ ) :
    Texture( name_, GL_TEXTURE_2D, format_, filtered_, mipmapped_, repeat_ ){
@@ -210,30 +222,217 @@ struct Texture2D : public Texture<2> {
 
   Texture2D(const char *name_, MyGL_ROImage image, const char *format_, bool filtered_, bool mipmapped_, bool repeat_)
       :
-      Texture(name_, GL_TEXTURE_2D, format_, filtered_, mipmapped_, repeat_) {
+      Texture2D(name_, image, format_, MyGL_TextureOptions { .filtered = filtered_, .mipmapped = mipmapped_, .repeat = repeat_, .mipOptions = { }, .cacheKey = 0, .progressive = GL_FALSE, .immutable = GL_FALSE, .gpuMipmaps = GL_FALSE }) {
+  }
+
+  Texture2D(const char *name_, MyGL_ROImage image, const char *format_, const MyGL_TextureOptions &options)
+      :
+      Texture(name_, GL_TEXTURE_2D, format_, options.filtered, options.mipmapped, options.repeat) {
     sizes[0] = image.w;
     sizes[1] = image.h;
-    if (!mipmapped) {
-      numMips = 1;
+    immutable = options.immutable;
+    bc::Format compressed = bc::formatFor(format.sizedFormat);
+    if (immutable && !image.pixels) {
+      // sized up front, contents come later through pushData
+      allocate(mipmapped ? levelCount(image.w, image.h) : 1);
+    } else if (mipmapped && options.gpuMipmaps && compressed == bc::Format::None) {
+      allocate(levelCount(image.w, image.h));
+      defineLevel(0, image.w, image.h, GL_BGRA, image.pixels);
+      glGenerateMipmap( GL_TEXTURE_2D);
+    } else if (compressed != bc::Format::None) {
+      uploadCompressed(compressed, image, options);
+    } else if (!mipmapped) {
+      allocate(1);
       // utils::logout( " - creating texture" );
       if (format.baseFormat == GL_DEPTH_STENCIL) {
-        glTexImage2D( GL_TEXTURE_2D, 0, format.sizedFormat, image.w, image.h, 0, GL_DEPTH_COMPONENT, GL_UNSIGNED_BYTE, image.pixels);
+        defineLevel(0, image.w, image.h, GL_DEPTH_COMPONENT, image.pixels);
 
       } else {
-        glTexImage2D( GL_TEXTURE_2D, 0, format.sizedFormat, image.w, image.h, 0, GL_BGRA, GL_UNSIGNED_BYTE, image.pixels);
+        defineLevel(0, image.w, image.h, GL_BGRA, image.pixels);
       }
     } else {
       // utils::logout(" - creating mip-mapped texture");
-      MyGL_MipChain chain = MyGL_mipChainCreate(image);
-      for (size_t i = 0; i < chain.count; i++) {
-        glTexImage2D( GL_TEXTURE_2D, numMips++, format.sizedFormat, chain.levels[i].w, chain.levels[i].h, 0, GL_BGRA,
-        GL_UNSIGNED_BYTE,
-                     chain.levels[i].pixels);
-      }
+      MyGL_MipOptions mipOptions = options.mipOptions;
+      mipOptions.borrowLevel0 = 1;  // image outlives the upload
+      MyGL_MipChain chain = MyGL_mipChainCreateFiltered(image, &mipOptions);
+      allocate(chain.count);
+      for (size_t i = 0; i < chain.count; i++)
+        defineLevel(i, chain.levels[i].w, chain.levels[i].h, GL_BGRA, chain.levels[i].pixels);
       MyGL_mipChainFree(&chain);
     }
   }
 
+  // levels already in their upload layout, as read from a cooked cache file or a DDS/KTX2 container
+  Texture2D(const char *name_, const std::vector<texcache::Level> &levels, const char *format_, const MyGL_TextureOptions &options, GLenum pixelFormat = GL_BGRA)
+      :
+      Texture(name_, GL_TEXTURE_2D, format_, options.filtered, options.mipmapped, options.repeat) {
+    sizes[0] = levels[0].w;
+    sizes[1] = levels[0].h;
+    immutable = options.immutable;
+    allocate(levels.size());
+    for (size_t i = 0; i < levels.size(); i++) {
+      if (format.blockBytes)
+        defineCompressedLevel(i, levels[i].w, levels[i].h, levels[i].size, levels[i].data);
+      else
+        defineLevel(i, levels[i].w, levels[i].h, pixelFormat, levels[i].data);
+    }
+    // containers often stop short of 1x1, sampling past the last level would make the texture incomplete
+    glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, (GLint) numMips - 1);
+  }
+
+  // single/dual channel and half float texels go up in their own layout, the driver has nothing to convert
+  Texture2D(const char *name_, MyGL_TypedImage image, const char *format_, const MyGL_TextureOptions &options)
+      :
+      Texture(name_, GL_TEXTURE_2D, format_, options.filtered, options.mipmapped, options.repeat) {
+    sizes[0] = image.w;
+    sizes[1] = image.h;
+    immutable = options.immutable;
+    static const GLenum pixelFormats[] = { GL_RED, GL_RG, GL_RED, GL_RGBA };
+    static const GLenum types[] = { GL_UNSIGNED_BYTE, GL_UNSIGNED_BYTE, GL_HALF_FLOAT, GL_HALF_FLOAT };
+    GLenum pixelFormat = pixelFormats[image.type], type = types[image.type];
+    // rows of 1 and 2 byte texels aren't 4 byte aligned
+    glPixelStorei( GL_UNPACK_ALIGNMENT, 1);
+    allocate(mipmapped ? levelCount(image.w, image.h) : 1);
+    defineLevel(0, image.w, image.h, pixelFormat, image.pixels, type);
+    if (mipmapped && options.gpuMipmaps) {
+      glGenerateMipmap( GL_TEXTURE_2D);
+    } else if (mipmapped) {
+      MyGL_TypedImage level = image;
+      for (size_t i = 1; i < numMips; i++) {
+        MyGL_TypedImage next = MyGL_typedImageMip(level);
+        defineLevel(i, next.w, next.h, pixelFormat, next.pixels, type);
+        if (i > 1)
+          MyGL_typedImageFree(&level);
+        level = next;
+      }
+      if (numMips > 1)
+        MyGL_typedImageFree(&level);
+    }
+    glPixelStorei( GL_UNPACK_ALIGNMENT, 4);
+  }
+
+  static size_t levelCount(uint32_t w, uint32_t h) {
+    size_t count = 1;
+    while (w >> count || h >> count)
+      count++;
+    return count;
+  }
+
+  // immutable textures get all of their levels here, mutable ones as each level is defined
+  void allocate(size_t count) {
+    numMips = count;
+    if (immutable)
+      glTexStorage2D( GL_TEXTURE_2D, (GLsizei) count, format.sizedFormat, sizes[0], sizes[1]);
+  }
+
+  void defineLevel(GLint level, GLsizei w, GLsizei h, GLenum pixelFormat, const void *pixels, GLenum type = GL_UNSIGNED_BYTE) {
+    if (!immutable)
+      glTexImage2D( GL_TEXTURE_2D, level, format.sizedFormat, w, h, 0, pixelFormat, type, pixels);
+    else if (pixels)
+      glTexSubImage2D( GL_TEXTURE_2D, level, 0, 0, w, h, pixelFormat, type, pixels);
+  }
+
+  void defineCompressedLevel(GLint level, GLsizei w, GLsizei h, size_t size, const void *blocks) {
+    if (!immutable)
+      glCompressedTexImage2D( GL_TEXTURE_2D, level, format.sizedFormat, w, h, 0, (GLsizei) size, blocks);
+    else
+      glCompressedTexSubImage2D( GL_TEXTURE_2D, level, 0, 0, w, h, format.sizedFormat, (GLsizei) size, blocks);
+  }
+
+  // encodes each level to blocks on the cpu so the driver never sees uncompressed texels
+  void uploadCompressed(bc::Format compressed, MyGL_ROImage image, const MyGL_TextureOptions &options) {
+    std::vector<uint8_t> blocks(bc::encodedSize(compressed, image.w, image.h));
+    auto upload = [&](GLint i, MyGL_ROImage level) {
+      bc::encode(compressed, level, blocks.data(), options.mipOptions.threads);
+      defineCompressedLevel(i, level.w, level.h, bc::encodedSize(compressed, level.w, level.h), blocks.data());
+    };
+    if (!mipmapped) {
+      allocate(1);
+      upload(0, image);
+      return;
+    }
+    MyGL_MipOptions mipOptions = options.mipOptions;
+    mipOptions.borrowLevel0 = 1;
+    MyGL_MipChain chain = MyGL_mipChainCreateFiltered(image, &mipOptions);
+    allocate(chain.count);
+    for (size_t i = 0; i < chain.count; i++)
+      upload(i, toRo(chain.levels[i]));
+    MyGL_mipChainFree(&chain);
+  }
+
+  // replaces the texture's storage with an uploaded one (streamed textures swap out their placeholder)
+  // levels above baseLevel_ may still be undefined, sampling is clamped to the ones that are there
+  void adopt(GLuint tex_, uint32_t w, uint32_t h, size_t numMips_, size_t baseLevel_ = 0) {
+    if (glIsTexture(tex))
+      glDeleteTextures(1, &tex);
+    tex = tex_;
+    sizes[0] = w;
+    sizes[1] = h;
+    numMips = numMips_;
+    mipmapped = numMips > 1;
+    glActiveTexture( MYGL_TEXTURE_USAGE_UNIT);
+    glBindTexture(target, tex);
+    setParameters();
+    setBaseLevel(baseLevel_);
+    glTexParameteri(target, GL_TEXTURE_MAX_LEVEL, (GLint) numMips - 1);
+    resident = true;
+  }
+
+  // rebuilds levels 1+ from level 0 with glGenerateMipmap (drivers filter sRGB formats in linear space)
+  // a render target without mips gets its chain here, fixed-size immutable storage and compressed formats can't
+  bool generateMipmaps() {
+    if (format.blockBytes || (!mipmapped && immutable))
+      return false;
+    glActiveTexture( MYGL_TEXTURE_USAGE_UNIT);
+    glBindTexture(target, tex);
+    if (!mipmapped) {
+      mipmapped = true;
+      numMips = levelCount(sizes[0], sizes[1]);
+      setParameters();
+    }
+    glGenerateMipmap(target);
+    return true;
+  }
+
+  // expects the texture bound on the current unit
+  void setBaseLevel(size_t level) {
+    baseLevel = level;
+    glTexParameteri(target, GL_TEXTURE_BASE_LEVEL, (GLint) level);
+  }
+
+  // drops the storage for a 1x1 stand-in, whoever evicts is responsible for bringing it back
+  void evict() {
+    MyGL_Color grey;
+    grey.value = 0xff808080;
+    GLuint standIn;
+    glGenTextures(1, &standIn);
+    glBindTexture( GL_TEXTURE_2D, standIn);
+    if (format.blockBytes) {
+      uint8_t block[16];
+      bc::encode(bc::formatFor(format.sizedFormat), MyGL_ROImage { .w = 1, .h = 1, .pixels = &grey }, block, 1);
+      glCompressedTexImage2D( GL_TEXTURE_2D, 0, format.sizedFormat, 1, 1, 0, format.blockBytes, block);
+    } else {
+      glTexImage2D( GL_TEXTURE_2D, 0, format.sizedFormat, 1, 1, 0, GL_BGRA, GL_UNSIGNED_BYTE, &grey);
+    }
+    adopt(standIn, 1, 1, 1);
+    resident = false;
+  }
+
+  // estimated video memory, drivers pad 24-bit texels to 32
+  size_t footprint() const {
+    size_t texel = (format.rgbaSize[0] + format.rgbaSize[1] + format.rgbaSize[2] + format.rgbaSize[3] + format.depthBits + format.stencilBits + 7) / 8;
+    if (texel == 3)
+      texel = 4;
+    size_t bytes = 0, w = sizes[0], h = sizes[1];
+    for (size_t i = 0; i < numMips; i++) {
+      if (i >= baseLevel)
+        bytes += format.blockBytes ? ((w + 3) / 4) * ((h + 3) / 4) * format.blockBytes : w * h * texel;
+      w = w > 1 ? w / 2 : 1;
+      h = h > 1 ? h / 2 : 1;
+    }
+    return bytes;
+  }
+
   size_t numMipLevels() override {
     return numMips;
   }
@@ -247,7 +446,10 @@ struct Texture2D : public Texture<2> {
       return;
     glActiveTexture(unit);
     glBindTexture(target, tex);
-    glTexSubImage2D(target, level, x, y, w, h, format, type, pixels.p);
+    // staged through the unpack ring so the call returns before the GPU has read the pixels
+    unpackring::upload(pixels.p, unpackring::imageBytes(w, h, format, type), [&](const void *src) {
+      glTexSubImage2D(target, level, x, y, w, h, format, type, src);
+    });
   }
 
   /*
@@ -277,67 +479,114 @@ struct Texture2DArray : public Texture<3> {
 
   Texture2DArray(const char *name_, MyGL_ROImage atlas, uint32_t rows, uint32_t cols, const char *format_, bool filtered_, bool mipmapped_, bool repeat_)
       :
-      Texture(name_, GL_TEXTURE_2D_ARRAY, format_, filtered_, mipmapped_, repeat_) {
+      Texture2DArray(name_, atlas, rows, cols, format_, MyGL_TextureOptions { .filtered = filtered_, .mipmapped = mipmapped_, .repeat = repeat_, .mipOptions = { }, .cacheKey = 0, .progressive = GL_FALSE, .immutable = GL_FALSE, .gpuMipmaps = GL_FALSE }) {
+  }
+
+  Texture2DArray(const char *name_, MyGL_ROImage atlas, uint32_t rows, uint32_t cols, const char *format_, const MyGL_TextureOptions &options)
+      :
+      Texture(name_, GL_TEXTURE_2D_ARRAY, format_, options.filtered, options.mipmapped, options.repeat) {
     sizes[0] = atlas.w / cols;
     sizes[1] = atlas.h / rows;
     sizes[2] = rows * cols;
 
-    MyGL_Image cell = MyGL_imageAlloc(sizes[0], sizes[1]);
-    MyGL_MipChain mips;
-
-    auto getCell = [&](uint32_t r, uint32_t c) {
-      uint32_t yoff = r * cell.h;
-      uint32_t xoff = c * cell.w;
-      for (uint32_t y = 0; y < cell.h; y++) {
-        for (uint32_t x = 0; x < cell.w; x++) {
-          cell.pixels[y * cell.w + x] = atlas.pixels[(yoff + y) * atlas.w + (xoff + x)];
-        }
+    // cells are read in place, the unpack state walks the atlas rows instead of copying each cell out
+    auto cellPixels = [&](uint32_t layer) {
+      return &atlas.pixels[(size_t) (layer / cols) * sizes[1] * atlas.w + (layer % cols) * sizes[0]];
+    };
+    auto uploadCells = [&]() {
+      glPixelStorei( GL_UNPACK_ROW_LENGTH, atlas.w);
+      for (uint32_t layer = 0; layer < sizes[2]; layer++) {
+        glPixelStorei( GL_UNPACK_SKIP_PIXELS, (layer % cols) * sizes[0]);
+        glPixelStorei( GL_UNPACK_SKIP_ROWS, (layer / cols) * sizes[1]);
+        glTexSubImage3D( GL_TEXTURE_2D_ARRAY, 0, 0, 0, layer, sizes[0], sizes[1], 1, GL_BGRA, GL_UNSIGNED_BYTE, atlas.pixels);
       }
+      glPixelStorei( GL_UNPACK_ROW_LENGTH, 0);
+      glPixelStorei( GL_UNPACK_SKIP_PIXELS, 0);
+      glPixelStorei( GL_UNPACK_SKIP_ROWS, 0);
     };
 
     if (!mipmapped) {
       numMips = 1;
       utils::logout("creating texture array");
       glTexImage3D( GL_TEXTURE_2D_ARRAY, 0, format.sizedFormat, sizes[0], sizes[1], sizes[2], 0, GL_BGRA, GL_UNSIGNED_BYTE, nullptr);
-      uint32_t layer = 0;
-      for (uint32_t r = 0; r < rows; r++) {
-        for (uint32_t c = 0; c < cols; c++) {
-          getCell(r, c);
-          glTexSubImage3D( GL_TEXTURE_2D_ARRAY, 0, 0, 0, layer++, cell.w, cell.h, 1, GL_BGRA, GL_UNSIGNED_BYTE, cell.pixels);
-        }
-      }
+      uploadCells();
+    } else if (options.gpuMipmaps) {
+      numMips = Texture2D::levelCount(sizes[0], sizes[1]);
+      glTexImage3D( GL_TEXTURE_2D_ARRAY, 0, format.sizedFormat, sizes[0], sizes[1], sizes[2], 0, GL_BGRA, GL_UNSIGNED_BYTE, nullptr);
+      uploadCells();
+      glGenerateMipmap( GL_TEXTURE_2D_ARRAY);
     } else {
-      auto getMipMaps = [&](bool freeMem = true) {
-        if (freeMem)
-          MyGL_mipChainFree(&mips);
-        mips = MyGL_mipChainCreate(toRo(cell));
-      };
+      // levels 1+ of every cell share one block, each level holds all layers back to back so it uploads in one call
+      std::vector<MyGL_Image> levels = { MyGL_Image { .w = (uint32_t) sizes[0], .h = (uint32_t) sizes[1], .pixels = nullptr } };
+      size_t total = 0;
+      while (levels.back().w > 1 || levels.back().h > 1) {
+        const MyGL_Image &prev = levels.back();
+        MyGL_Image level = { .w = prev.w > 1 ? prev.w / 2 : 1, .h = prev.h > 1 ? prev.h / 2 : 1, .pixels = nullptr };
+        total += (size_t) level.w * level.h * sizes[2];
+        levels.push_back(level);
+      }
+      std::vector<MyGL_Color> arena(total);
+      MyGL_Color *next = arena.data();
+      for (size_t i = 1; i < levels.size(); i++) {
+        levels[i].pixels = next;
+        next += (size_t) levels[i].w * levels[i].h * sizes[2];
+      }
 
-      // utils::logout("creating mip-mapped texture array");
-      getCell(0, 0);
-      getMipMaps(false);
-      numMips = mips.count;
-      for (size_t i = 0; i < mips.count; i++)
-        glTexImage3D( GL_TEXTURE_2D_ARRAY, i, format.sizedFormat, mips.levels[i].w, mips.levels[i].h, sizes[2], 0, GL_BGRA,
-        GL_UNSIGNED_BYTE,
-                     nullptr);
-
-      uint32_t layer = 0;
-      for (uint32_t r = 0; r < rows; r++) {
-        for (uint32_t c = 0; c < cols; c++) {
-          getCell(r, c);
-          getMipMaps();
-          for (size_t i = 0; i < mips.count; i++)
-            glTexSubImage3D( GL_TEXTURE_2D_ARRAY, i, 0, 0, layer, mips.levels[i].w, mips.levels[i].h, 1, GL_BGRA,
-            GL_UNSIGNED_BYTE,
-                            mips.levels[i].pixels);
-          layer++;
+      auto buildCell = [&](uint32_t layer) {
+        MyGL_ROImage prev = { .w = levels[0].w, .h = levels[0].h, .pixels = cellPixels(layer) };
+        uint32_t pitch = atlas.w;
+        for (size_t i = 1; i < levels.size(); i++) {
+          MyGL_Image level = levels[i];
+          level.pixels += (size_t) layer * level.w * level.h;
+          mipRows(prev, pitch, level, 0, level.h);
+          prev = toRo(level);
+          pitch = level.w;
         }
+      };
+      if (getSize() < 256 * 256) {
+        for (uint32_t layer = 0; layer < sizes[2]; layer++)
+          buildCell(layer);
+      } else {
+        utils::TaskGroup tasks;
+        for (uint32_t layer = 0; layer < sizes[2]; layer++)
+          tasks.enqueue([&, layer]() {
+            buildCell(layer);
+          });
+        tasks.wait();
       }
-      MyGL_mipChainFree(&mips);
+
+      // utils::logout("creating mip-mapped texture array");
+      numMips = levels.size();
+      glTexImage3D( GL_TEXTURE_2D_ARRAY, 0, format.sizedFormat, sizes[0], sizes[1], sizes[2], 0, GL_BGRA, GL_UNSIGNED_BYTE, nullptr);
+      uploadCells();
+      for (size_t i = 1; i < levels.size(); i++)
+        glTexImage3D( GL_TEXTURE_2D_ARRAY, i, format.sizedFormat, levels[i].w, levels[i].h, sizes[2], 0, GL_BGRA, GL_UNSIGNED_BYTE, levels[i].pixels);
     }
+  }
 
-    MyGL_imageFree(&cell);
+  // [layer][level] in their upload layout (a DDS/KTX2 container), each layer goes straight from where it sits
+  Texture2DArray(const char *name_, const std::vector<std::vector<texcache::Level> > &layers, const char *format_, const MyGL_TextureOptions &options, GLenum pixelFormat)
+      :
+      Texture(name_, GL_TEXTURE_2D_ARRAY, format_, options.filtered, options.mipmapped, options.repeat) {
+    sizes[0] = layers[0][0].w;
+    sizes[1] = layers[0][0].h;
+    sizes[2] = layers.size();
+    numMips = layers[0].size();
+    for (size_t i = 0; i < numMips; i++) {
+      const texcache::Level &level = layers[0][i];
+      if (format.blockBytes)
+        glCompressedTexImage3D( GL_TEXTURE_2D_ARRAY, i, format.sizedFormat, level.w, level.h, sizes[2], 0, (GLsizei) (level.size * sizes[2]), nullptr);
+      else
+        glTexImage3D( GL_TEXTURE_2D_ARRAY, i, format.sizedFormat, level.w, level.h, sizes[2], 0, pixelFormat, GL_UNSIGNED_BYTE, nullptr);
+      for (size_t layer = 0; layer < sizes[2]; layer++) {
+        const texcache::Level &slice = layers[layer][i];
+        if (format.blockBytes)
+          glCompressedTexSubImage3D( GL_TEXTURE_2D_ARRAY, i, 0, 0, layer, slice.w, slice.h, 1, format.sizedFormat, (GLsizei) slice.size, slice.data);
+        else
+          glTexSubImage3D( GL_TEXTURE_2D_ARRAY, i, 0, 0, layer, slice.w, slice.h, 1, pixelFormat, GL_UNSIGNED_BYTE, slice.data);
+      }
+    }
+    glTexParameteri( GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAX_LEVEL, (GLint) numMips - 1);
   }
 
   size_t numMipLevels() override {
@@ -0,0 +1,129 @@
+#include "utils/log.h"
+
+#include "unpackring.h"
+
+#include <cstring>
+#include <deque>
+
+namespace mygl {
+
+namespace unpackring {
+
+namespace {
+
+const size_t ringBytes = 8 * 1024 * 1024;
+const size_t alignment = 256;  // keeps every region aligned for any texel type
+
+struct Region {
+  size_t begin;
+  GLsync fence;
+};
+
+GLuint pbo = 0;
+uint8_t *mapped = nullptr;
+bool unsupported = false;
+size_t head = 0;
+std::deque<Region> regions;  // oldest first
+
+bool create() {
+  if (!GLEW_ARB_buffer_storage) {
+    unsupported = true;
+    if (MyGL_Debug_getChatty())
+      utils::logout("%s - no ARB_buffer_storage, texture updates read client memory", __func__);
+    return false;
+  }
+  GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+  glGenBuffers(1, &pbo);
+  glBindBuffer( GL_PIXEL_UNPACK_BUFFER, pbo);
+  glBufferStorage( GL_PIXEL_UNPACK_BUFFER, ringBytes, nullptr, flags);
+  mapped = (uint8_t*) glMapBufferRange( GL_PIXEL_UNPACK_BUFFER, 0, ringBytes, flags);
+  glBindBuffer( GL_PIXEL_UNPACK_BUFFER, 0);
+  if (!mapped) {
+    utils::logout("%s error: could not map the unpack ring", __func__);
+    glDeleteBuffers(1, &pbo);
+    pbo = 0;
+    unsupported = true;
+    return false;
+  }
+  return true;
+}
+
+// offset of a free region of size bytes, or ringBytes if the GPU still reads the space it needs
+size_t reserve(size_t size) {
+  size_t start = head + size <= ringBytes ? head : 0;
+  size_t need = start == head ? size : ringBytes - head + size;  // wrapping also gives up the tail
+  while (!regions.empty()) {
+    Region &oldest = regions.front();
+    if ((oldest.begin + ringBytes - head) % ringBytes >= need)
+      break;
+    if (glClientWaitSync(oldest.fence, 0, 0) == GL_TIMEOUT_EXPIRED)
+      return ringBytes;
+    glDeleteSync(oldest.fence);
+    regions.pop_front();
+  }
+  if (regions.empty())
+    start = 0;  // nothing in flight, start over from the front
+  return start;
+}
+
+}
+
+size_t imageBytes(GLsizei w, GLsizei h, MyGL_WriteFormat format, MyGL_ReadWriteType type) {
+  size_t components = 1;
+  switch (format) {
+    case MYGL_WRITE_RG:
+      components = 2;
+      break;
+    case MYGL_WRITE_RGB:
+    case MYGL_WRITE_BGR:
+      components = 3;
+      break;
+    case MYGL_WRITE_RGBA:
+    case MYGL_WRITE_BGRA:
+      components = 4;
+      break;
+    default:
+      break;
+  }
+  size_t bytes = 1;
+  switch (type) {
+    case MYGL_READWRITE_SHORT:
+    case MYGL_READWRITE_USHORT:
+      bytes = 2;
+      break;
+    case MYGL_READWRITE_INT:
+    case MYGL_READWRITE_UINT:
+    case MYGL_READWRITE_FLOAT:
+    case MYGL_READWRITE_UINT_248:
+      bytes = 4;
+      break;
+    default:
+      break;
+  }
+  size_t row = w * components * bytes;
+  return h ? ((row + 3) & ~(size_t) 3) * (h - 1) + row : 0;
+}
+
+void upload(const void *pixels, size_t size, const std::function<void(const void*)> &issue) {
+  if (!pixels || !size || size > ringBytes / 2 || unsupported || (!pbo && !create())) {
+    issue(pixels);
+    return;
+  }
+  size_t offset = reserve(size);
+  if (offset == ringBytes) {
+    issue(pixels);  // the driver copies it, still cheaper than waiting on a fence
+    return;
+  }
+
+  memcpy(mapped + offset, pixels, size);
+  glBindBuffer( GL_PIXEL_UNPACK_BUFFER, pbo);
+  issue((const void*) offset);
+  glBindBuffer( GL_PIXEL_UNPACK_BUFFER, 0);
+  size_t end = (offset + size + alignment - 1) & ~(alignment - 1);
+  regions.push_back(Region { .begin = offset, .fence = glFenceSync( GL_SYNC_GPU_COMMANDS_COMPLETE, 0) });
+  head = end % ringBytes;
+}
+
+}
+
+}
@@ -0,0 +1,21 @@
+#pragma once
+
+#include "public/mygl.h"
+
+#include <functional>
+
+namespace mygl {
+
+// one persistent-mapped pixel unpack buffer shared by every texture update, regions are recycled behind fences
+namespace unpackring {
+
+// bytes glTexSubImage2D reads for a w x h rectangle with the default unpack alignment (4)
+size_t imageBytes(GLsizei w, GLsizei h, MyGL_WriteFormat format, MyGL_ReadWriteType type);
+
+// copies the pixels into the ring and calls issue with the offset to pass as the pixels pointer while the ring is bound
+// to GL_PIXEL_UNPACK_BUFFER; issue gets the client pointer instead when the ring is unsupported, too small or still busy
+void upload(const void *pixels, size_t size, const std::function<void(const void*)> &issue);
+
+}
+
+}
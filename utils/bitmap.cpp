@@ -1,8 +1,10 @@
 #include <cstdint>
+#include <cstdio>
 #include <cstring>
 
 #include "log.h"
 #include "bitmap.h"
+#include "pixels.h"
 
 namespace utils {
 namespace bmp {
@@ -43,53 +45,202 @@ struct DibHeader {
 
 #pragma pack(pop)
 
-MyGL_Image imageFromBitmapData(const std::vector<uint8_t> rawData, std::string_view source) {
+namespace {
+
+// 16384 x 16384: a 1GB image, well short of where MyGL_imageAlloc's 32-bit pixel count wraps
+const uint64_t maxPixels = 1ull << 28;
+
+struct Masks {
+  uint32_t r = 0x00ff0000u, g = 0x0000ff00u, b = 0x000000ffu, a = 0;
+
+  bool standard() const {
+    return r == 0x00ff0000u && g == 0x0000ff00u && b == 0x000000ffu && (a == 0 || a == 0xff000000u);
+  }
+};
+
+uint8_t maskedChannel(uint32_t p, uint32_t mask) {
+  if (!mask)
+    return 255;
+  int shift = __builtin_ctz(mask);
+  uint32_t max = mask >> shift;
+  return (uint8_t) ((((p & mask) >> shift) * 255 + max / 2) / max);
+}
+
+bool decodeRle8(const uint8_t *in, const uint8_t *end, MyGL_Image &image, const uint32_t *palette) {
+  uint32_t *pixels = (uint32_t*) image.pixels;
+  uint32_t x = 0, y = 0;
+  while (in + 2 <= end) {
+    uint8_t n = in[0], v = in[1];
+    in += 2;
+    if (n) {
+      for (uint8_t i = 0; i < n && x < image.w && y < image.h; i++)
+        pixels[y * image.w + x++] = palette[v];
+      continue;
+    }
+    switch (v) {
+      case 0:  // end of line
+        x = 0;
+        y++;
+        break;
+      case 1:  // end of bitmap
+        return true;
+      case 2:  // delta
+        if (in + 2 > end)
+          return false;
+        x += in[0];
+        y += in[1];
+        in += 2;
+        break;
+      default:  // absolute run, padded to 16 bits
+        if (in + v > end)
+          return false;
+        for (uint8_t i = 0; i < v && x < image.w && y < image.h; i++)
+          pixels[y * image.w + x++] = palette[in[i]];
+        in += v + (v & 0x01);
+        break;
+    }
+  }
+  return true;
+}
+
+}
+
+MyGL_Image imageFromBitmapData(const void *data, size_t size, std::string_view source) {
   MyGL_Image image = { .w = 0, .h = 0, .pixels = nullptr };
-  if (!rawData.size())
+  const uint8_t *bytes = (const uint8_t*) data;
+  if (!bytes || size < sizeof(FileMagic) + sizeof(FileHeader) + sizeof(DibHeader))
     return image;
 
-  size_t streamPos = 0;
-
-  const FileMagic *magic = (const FileMagic*) &rawData[streamPos];
-  if (magic->num0 != 'B' && magic->num1 != 'M') {
+  const FileMagic *magic = (const FileMagic*) bytes;
+  if (magic->num0 != 'B' || magic->num1 != 'M') {
     utils::logout("error: '%s' is not a valid bitmap image", source.data());
     return image;
   }
-  streamPos += sizeof(FileMagic);
+  const FileHeader *header = (const FileHeader*) &bytes[sizeof(FileMagic)];
+  const DibHeader *dib = (const DibHeader*) &bytes[sizeof(FileMagic) + sizeof(FileHeader)];
+  if (dib->headerSize > size - sizeof(FileMagic) - sizeof(FileHeader)) {
+    utils::logout("error: '%s' bitmap header is truncated", source.data());
+    return image;
+  }
+  const uint8_t *dibEnd = (const uint8_t*) dib + dib->headerSize;
+
+  bool rle = dib->compression == Compression::RLE8;
+  bool bitfields = dib->compression == Compression::BITFIELDS;
+  bool supported = dib->headerSize >= sizeof(DibHeader) && dib->width > 0 && dib->height != 0 && dib->numPlanes == 1;
+  supported = supported && ((dib->bitsPerPixel == 8 && (dib->compression == Compression::RGB || rle)) ||
+      (dib->bitsPerPixel == 24 && dib->compression == Compression::RGB) ||
+      (dib->bitsPerPixel == 32 && (dib->compression == Compression::RGB || bitfields)));
+  if (!supported) {
+    utils::logout("error: '%s' is not a supported bitmap image (%u bpp, compression %u)", source.data(), dib->bitsPerPixel, dib->compression);
+    return image;
+  }
 
-  const FileHeader *header = (const FileHeader*) &rawData[streamPos];
-  streamPos += sizeof(FileHeader);
+  // masks follow the 40 byte header, inside it for v3+ headers
+  Masks masks;
+  if (bitfields) {
+    const uint32_t *m = (const uint32_t*) ((const uint8_t*) dib + sizeof(DibHeader));
+    size_t available = dib->headerSize > sizeof(DibHeader) ? (dib->headerSize - sizeof(DibHeader)) / 4 : 3;
+    if ((const uint8_t*) (m + (available >= 4 ? 4 : 3)) > bytes + size)
+      return image;
+    masks.r = m[0];
+    masks.g = m[1];
+    masks.b = m[2];
+    masks.a = available >= 4 ? m[3] : 0;
+    if (dib->headerSize == sizeof(DibHeader))
+      dibEnd += 12;
+  }
 
-  const DibHeader *dib = (const DibHeader*) &rawData[streamPos];
-  if (dib->compression != Compression::RGB || dib->bitsPerPixel != 24) {
-    utils::logout("error: '%s' is not a 24 bit bitmap image", source.data());
-    return image;
+  uint32_t palette[256];
+  if (dib->bitsPerPixel == 8) {
+    uint32_t numColors = dib->numPalColors ? dib->numPalColors : 256;
+    numColors = numColors > 256 ? 256 : numColors;
+    if (dibEnd + numColors * 4 > bytes + size) {
+      utils::logout("error: '%s' bitmap palette is truncated", source.data());
+      return image;
+    }
+    memset(palette, 0, sizeof(palette));
+    for (uint32_t i = 0; i < numColors; i++)
+      palette[i] = (uint32_t) dibEnd[i * 4] | ((uint32_t) dibEnd[i * 4 + 1] << 8) | ((uint32_t) dibEnd[i * 4 + 2] << 16) | 0xff000000u;
   }
 
-  image.w = dib->width;
-  image.h = dib->height;
-  image.pixels = new MyGL_Color[image.w * image.h];
+  bool topDown = dib->height < 0;
+  uint32_t w = (uint32_t) dib->width;
+  uint32_t h = (uint32_t) (topDown ? -(int64_t) dib->height : dib->height);
+  // RLE8 data doesn't bound the size by the file, check it before allocating
+  if ((uint64_t) w * h > maxPixels) {
+    utils::logout("error: '%s' bitmap is too large (%ux%u)", source.data(), w, h);
+    return image;
+  }
+  size_t stride = (((size_t) w * dib->bitsPerPixel + 31) / 32) * 4;
+  if (header->dataOffset >= size || (!rle && header->dataOffset + stride * h > size)) {
+    utils::logout("error: '%s' bitmap pixel data is truncated", source.data());
+    return image;
+  }
 
-  int bypp = dib->bitsPerPixel / 8;
-  int rem = 0;
-  if ((image.w * bypp) & 0x03) {
-    rem = 4 - ((image.w * bypp) & 0x03);
+  image = MyGL_imageAlloc(w, h);
+  uint32_t *pixels = (uint32_t*) image.pixels;
+  const uint8_t *in = &bytes[header->dataOffset];
+
+  if (rle) {
+    if (topDown)
+      utils::logout("warning: '%s' top-down RLE8 bitmap, rows are stored bottom-up anyway", source.data());
+    for (size_t i = 0; i < (size_t) w * h; i++)
+      pixels[i] = palette[0];
+    if (!decodeRle8(in, bytes + size, image, palette))
+      utils::logout("warning: '%s' RLE8 data is truncated", source.data());
+    return image;
   }
 
-  streamPos = header->dataOffset;
-  for (uint32_t y = 0; y < image.h; y++) {
-    for (uint32_t x = 0; x < image.w; x++) {
-      image.pixels[y * image.w + x].r = rawData[streamPos++];
-      image.pixels[y * image.w + x].g = rawData[streamPos++];
-      image.pixels[y * image.w + x].b = rawData[streamPos++];
-      image.pixels[y * image.w + x].a = 255;
+  bool opaque = !bitfields || !masks.a;
+  for (uint32_t y = 0; y < h; y++, in += stride) {
+    uint32_t *row = &pixels[(size_t) (topDown ? h - 1 - y : y) * w];
+    switch (dib->bitsPerPixel) {
+      case 8:
+        for (uint32_t x = 0; x < w; x++)
+          row[x] = palette[in[x]];
+        break;
+      case 24:
+        utils::pixels::expandRow24(row, in, w);
+        break;
+      case 32:
+        if (!bitfields || masks.standard()) {
+          utils::pixels::copyRow32(row, in, w, opaque);
+        } else {
+          for (uint32_t x = 0; x < w; x++) {
+            uint32_t p;
+            memcpy(&p, &in[x * 4], 4);
+            row[x] = (uint32_t) maskedChannel(p, masks.b) | ((uint32_t) maskedChannel(p, masks.g) << 8) | ((uint32_t) maskedChannel(p, masks.r) << 16)
+                | ((uint32_t) maskedChannel(p, masks.a) << 24);
+          }
+        }
+        break;
     }
-    for (int i = 0; i < rem; i++)
-      streamPos++;
   }
   return image;
 }
 
-}
+bool writeBitmapFile(const char *path, const void *pixels, uint32_t w, uint32_t h) {
+  FILE *fp = fopen(path, "wb");
+  if (!fp) {
+    utils::logout("%s error: cannot write '%s'", __func__, path);
+    return false;
+  }
+  uint32_t dataSize = w * h * 4;
+  FileMagic magic = { 'B', 'M' };
+  FileHeader header = { .fileSize = (uint32_t) (sizeof(FileMagic) + sizeof(FileHeader) + sizeof(DibHeader)) + dataSize, .creators = { 0, 0 }, .dataOffset =
+      (uint32_t) (sizeof(FileMagic) + sizeof(FileHeader) + sizeof(DibHeader)) };
+  // positive height: rows are stored bottom-up, the same order glReadPixels returns them in
+  DibHeader dib = { .headerSize = sizeof(DibHeader), .width = (int32_t) w, .height = (int32_t) h, .numPlanes = 1, .bitsPerPixel = 32, .compression = RGB, .dataSize =
+      dataSize, .hPixelsPer = 2835, .vPixelsPer = 2835, .numPalColors = 0, .numImportantColors = 0 };
+  bool ok = fwrite(&magic, sizeof(magic), 1, fp) == 1;
+  ok = ok && fwrite(&header, sizeof(header), 1, fp) == 1;
+  ok = ok && fwrite(&dib, sizeof(dib), 1, fp) == 1;
+  ok = ok && fwrite(pixels, 1, dataSize, fp) == dataSize;
+  ok = !fclose(fp) && ok;
+  if (!ok)
+    utils::logout("%s error: cannot write '%s'", __func__, path);
+  return ok;
 }
 
+}
+}
@@ -1,13 +1,17 @@
 #pragma once
 
 #include "../public/image.h"
-#include <vector>
+#include <cstddef>
 #include <string_view>
 
 namespace utils {
 namespace bmp {
 
-MyGL_Image imageFromBitmapData(std::vector<uint8_t> rawData, std::string_view source);
+// reads straight from the caller's bytes, 8 bit (RGB/RLE8), 24 bit and 32 bit (RGB/BITFIELDS), bottom-up or top-down
+MyGL_Image imageFromBitmapData(const void *data, size_t size, std::string_view source);
+
+// 32 bit BI_RGB, pixels are BGRA rows bottom-up (what GL reads back)
+bool writeBitmapFile(const char *path, const void *pixels, uint32_t w, uint32_t h);
 
 }
 }
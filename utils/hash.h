@@ -0,0 +1,52 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+namespace utils {
+
+namespace detail {
+
+inline uint64_t rotl(uint64_t v, int r) {
+  return (v << r) | (v >> (64 - r));
+}
+
+inline uint64_t round(uint64_t acc, uint64_t v) {
+  return rotl(acc + v * 0xc2b2ae3d27d4eb4full, 31) * 0x9e3779b185ebca87ull;
+}
+
+inline uint64_t avalanche(uint64_t h) {
+  h ^= h >> 33;
+  h *= 0xff51afd7ed558ccdull;
+  h ^= h >> 33;
+  h *= 0xc4ceb9fe1a85ec53ull;
+  return h ^ (h >> 33);
+}
+
+}
+
+// fast non-cryptographic 64-bit hash (xxh64-style, four independent lanes), for content keys
+inline uint64_t hash64(const void *data, size_t size, uint64_t seed = 0) {
+  const uint8_t *p = (const uint8_t*) data;
+  uint64_t lanes[4] = { seed + 0x9e3779b185ebca87ull, seed + 0xc2b2ae3d27d4eb4full, seed, seed - 0x9e3779b185ebca87ull };
+  size_t i = 0;
+  for (; i + 32 <= size; i += 32) {
+    for (int l = 0; l < 4; l++) {
+      uint64_t v;
+      memcpy(&v, p + i + l * 8, 8);
+      lanes[l] = detail::round(lanes[l], v);
+    }
+  }
+  uint64_t h = detail::rotl(lanes[0], 1) + detail::rotl(lanes[1], 7) + detail::rotl(lanes[2], 12) + detail::rotl(lanes[3], 18) + size;
+  for (; i + 8 <= size; i += 8) {
+    uint64_t v;
+    memcpy(&v, p + i, 8);
+    h = detail::round(h, v);
+  }
+  for (; i < size; i++)
+    h = detail::round(h, p[i]);
+  return detail::avalanche(h);
+}
+
+}
@@ -0,0 +1,88 @@
+#include "mapfile.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+utils::MappedFile::~MappedFile() {
+  close();
+}
+
+#ifdef _WIN32
+
+bool utils::MappedFile::open(const char *path) {
+  close();
+  HANDLE f = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+  if (f == INVALID_HANDLE_VALUE)
+    return false;
+  file = f;
+  LARGE_INTEGER size;
+  if (!GetFileSizeEx(f, &size) || !size.QuadPart) {
+    close();
+    return false;
+  }
+  mapping = CreateFileMappingA(f, nullptr, PAGE_READONLY, 0, 0, nullptr);
+  if (!mapping) {
+    close();
+    return false;
+  }
+  bytes = (const uint8_t*) MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+  if (!bytes) {
+    close();
+    return false;
+  }
+  length = (size_t) size.QuadPart;
+  return true;
+}
+
+void utils::MappedFile::close() {
+  if (bytes)
+    UnmapViewOfFile(bytes);
+  if (mapping)
+    CloseHandle(mapping);
+  if (file)
+    CloseHandle(file);
+  bytes = nullptr;
+  length = 0;
+  mapping = nullptr;
+  file = nullptr;
+}
+
+#else
+
+bool utils::MappedFile::open(const char *path) {
+  close();
+  fd = ::open(path, O_RDONLY);
+  if (fd < 0)
+    return false;
+  struct stat st;
+  if (fstat(fd, &st) || !st.st_size) {
+    close();
+    return false;
+  }
+  void *p = mmap(nullptr, (size_t) st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  if (p == MAP_FAILED) {
+    close();
+    return false;
+  }
+  bytes = (const uint8_t*) p;
+  length = (size_t) st.st_size;
+  return true;
+}
+
+void utils::MappedFile::close() {
+  if (bytes)
+    munmap((void*) bytes, length);
+  if (fd >= 0)
+    ::close(fd);
+  bytes = nullptr;
+  length = 0;
+  fd = -1;
+}
+
+#endif
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace utils {
+
+// read-only mapping of a whole file, unmapped on close/destruction
+class MappedFile {
+ public:
+  MappedFile() = default;
+  ~MappedFile();
+
+  MappedFile(const MappedFile&) = delete;
+  MappedFile& operator =(const MappedFile&) = delete;
+
+  bool open(const char *path);
+  void close();
+
+  const uint8_t* data() const {
+    return bytes;
+  }
+  size_t size() const {
+    return length;
+  }
+
+ private:
+  const uint8_t *bytes = nullptr;
+  size_t length = 0;
+#ifdef _WIN32
+  void *file = nullptr;
+  void *mapping = nullptr;
+#else
+  int fd = -1;
+#endif
+};
+
+}
@@ -0,0 +1,127 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSSE3__)
+#include <tmmintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#endif
+
+namespace utils {
+namespace pixels {
+
+// swaps bytes 0 and 2 of every 32 bit pixel (RGBA <-> BGRA)
+inline uint32_t swizzle(uint32_t p) {
+  return (p & 0xff00ff00u) | ((p >> 16) & 0xffu) | ((p & 0xffu) << 16);
+}
+
+#if defined(__AVX2__)
+inline __m256i swizzle(__m256i v) {
+  const __m256i mask = _mm256_setr_epi8(2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15, 2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15);
+  return _mm256_shuffle_epi8(v, mask);
+}
+#elif defined(__SSSE3__)
+inline __m128i swizzle(__m128i v) {
+  const __m128i mask = _mm_setr_epi8(2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15);
+  return _mm_shuffle_epi8(v, mask);
+}
+#elif defined(__SSE2__) || defined(_M_X64)
+inline __m128i swizzle(__m128i v) {
+  const __m128i ga = _mm_set1_epi32((int) 0xff00ff00u);
+  const __m128i lo = _mm_set1_epi32(0xff);
+  __m128i r = _mm_and_si128(_mm_srli_epi32(v, 16), lo);
+  __m128i b = _mm_slli_epi32(_mm_and_si128(v, lo), 16);
+  return _mm_or_si128(_mm_and_si128(v, ga), _mm_or_si128(r, b));
+}
+#endif
+
+// dst may equal src
+inline void swizzleRow(uint32_t *dst, const uint32_t *src, size_t n) {
+  size_t i = 0;
+#if defined(__AVX2__)
+  for (; i + 8 <= n; i += 8)
+    _mm256_storeu_si256((__m256i*) &dst[i], swizzle(_mm256_loadu_si256((const __m256i*) &src[i])));
+#elif defined(__SSE2__) || defined(_M_X64)
+  for (; i + 4 <= n; i += 4)
+    _mm_storeu_si128((__m128i*) &dst[i], swizzle(_mm_loadu_si128((const __m128i*) &src[i])));
+#endif
+  for (; i < n; i++)
+    dst[i] = swizzle(src[i]);
+}
+
+
+// 3 byte pixels to 4 byte pixels with alpha = 255, byte order is kept
+inline void expandRow24(uint32_t *dst, const uint8_t *src, size_t n) {
+  size_t i = 0;
+#if defined(__SSSE3__) || defined(__AVX2__)
+  const __m128i mask = _mm_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1);
+  const __m128i alpha = _mm_set1_epi32((int) 0xff000000u);
+  // 16 byte loads, stop early enough not to read past the last pixel
+  for (; i + 6 <= n; i += 4) {
+    __m128i v = _mm_loadu_si128((const __m128i*) &src[i * 3]);
+    _mm_storeu_si128((__m128i*) &dst[i], _mm_or_si128(_mm_shuffle_epi8(v, mask), alpha));
+  }
+#endif
+  for (; i < n; i++)
+    dst[i] = (uint32_t) src[i * 3] | ((uint32_t) src[i * 3 + 1] << 8) | ((uint32_t) src[i * 3 + 2] << 16) | 0xff000000u;
+}
+
+// 4 byte pixels, alpha forced to 255 when the source has none
+inline void copyRow32(uint32_t *dst, const uint8_t *src, size_t n, bool opaque) {
+  size_t i = 0;
+#if defined(__SSE2__) || defined(_M_X64)
+  const __m128i alpha = _mm_set1_epi32(opaque ? (int) 0xff000000u : 0);
+  for (; i + 4 <= n; i += 4)
+    _mm_storeu_si128((__m128i*) &dst[i], _mm_or_si128(_mm_loadu_si128((const __m128i*) &src[i * 4]), alpha));
+#endif
+  for (; i < n; i++) {
+    uint32_t p = (uint32_t) src[i * 4] | ((uint32_t) src[i * 4 + 1] << 8) | ((uint32_t) src[i * 4 + 2] << 16) | ((uint32_t) src[i * 4 + 3] << 24);
+    dst[i] = opaque ? p | 0xff000000u : p;
+  }
+}
+
+
+// IEEE half <-> float, round to nearest even, out of range values saturate to infinity
+inline uint16_t floatToHalf(float value) {
+  uint32_t f;
+  memcpy(&f, &value, 4);
+  uint32_t sign = (f >> 16) & 0x8000u;
+  f &= 0x7fffffffu;
+  if (f >= 0x47800000u)
+    return (uint16_t) (sign | (f > 0x7f800000u ? 0x7e00u : 0x7c00u));
+  if (f < 0x38800000u) {
+    // below the smallest normal half, adding 0.5 lets the fpu do the denormal rounding
+    float denorm;
+    memcpy(&denorm, &f, 4);
+    denorm += 0.5f;
+    memcpy(&f, &denorm, 4);
+    return (uint16_t) (sign | (f - 0x3f000000u));
+  }
+  uint32_t odd = (f >> 13) & 1u;
+  f += 0xc8000fffu + odd;
+  return (uint16_t) (sign | (f >> 13));
+}
+
+inline float halfToFloat(uint16_t h) {
+  uint32_t sign = (uint32_t) (h & 0x8000u) << 16, exp = (h >> 10) & 0x1fu, mant = h & 0x3ffu, bits;
+  if (exp == 0x1f)
+    bits = sign | 0x7f800000u | (mant << 13);
+  else if (exp)
+    bits = sign | ((exp + 112) << 23) | (mant << 13);
+  else {
+    float f = (float) mant * (1.0f / 16777216.0f);
+    memcpy(&bits, &f, 4);
+    bits |= sign;
+  }
+  float f;
+  memcpy(&f, &bits, 4);
+  return f;
+}
+
+}
+}
@@ -0,0 +1,114 @@
+#include "threads.h"
+
+utils::ThreadPool::ThreadPool(uint32_t numThreads) {
+  if (!numThreads)
+    numThreads = hardwareThreads();
+  for (uint32_t i = 0; i < numThreads; i++)
+    workers.emplace_back(&ThreadPool::workerLoop, this);
+}
+
+utils::ThreadPool::~ThreadPool() {
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    quit = true;
+  }
+  jobReady.notify_all();
+  for (auto &worker : workers)
+    worker.join();
+}
+
+uint32_t utils::ThreadPool::hardwareThreads() {
+  uint32_t n = std::thread::hardware_concurrency();
+  return n ? n : 1;
+}
+
+void utils::ThreadPool::enqueue(std::function<void()> job) {
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    jobs.push_back(std::move(job));
+  }
+  jobReady.notify_one();
+  jobsDone.notify_all();  // lets a waiting caller pick it up too
+}
+
+bool utils::ThreadPool::runOne(std::unique_lock<std::mutex> &lock) {
+  if (jobs.empty())
+    return false;
+  auto job = std::move(jobs.front());
+  jobs.pop_front();
+  running++;
+  lock.unlock();
+  job();
+  lock.lock();
+  running--;
+  if (jobs.empty() && !running)
+    jobsDone.notify_all();
+  return true;
+}
+
+void utils::ThreadPool::wait() {
+  std::unique_lock<std::mutex> lock(mutex);
+  while (!jobs.empty() || running) {
+    if (!runOne(lock))
+      jobsDone.wait(lock, [&]() {
+        return !jobs.empty() || !running;
+      });
+  }
+}
+
+void utils::ThreadPool::workerLoop() {
+  std::unique_lock<std::mutex> lock(mutex);
+  while (true) {
+    jobReady.wait(lock, [&]() {
+      return quit || !jobs.empty();
+    });
+    if (quit && jobs.empty())
+      return;
+    runOne(lock);
+  }
+}
+
+utils::ThreadPool& utils::sharedPool() {
+  static ThreadPool pool;
+  return pool;
+}
+
+void utils::TaskGroup::submit(std::function<void()> job) {
+  inPool++;
+  pool.jobs.push_back([this, job = std::move(job)]() {
+    job();
+    std::lock_guard<std::mutex> lock(pool.mutex);
+    inPool--;
+    pending--;
+    if (!held.empty()) {
+      submit(std::move(held.front()));
+      held.pop_front();
+      pool.jobReady.notify_one();
+    }
+    pool.jobsDone.notify_all();
+  });
+}
+
+void utils::TaskGroup::enqueue(std::function<void()> job) {
+  {
+    std::lock_guard<std::mutex> lock(pool.mutex);
+    pending++;
+    if (limit && inPool >= limit) {
+      held.push_back(std::move(job));
+      return;
+    }
+    submit(std::move(job));
+  }
+  pool.jobReady.notify_one();
+  pool.jobsDone.notify_all();
+}
+
+void utils::TaskGroup::wait() {
+  std::unique_lock<std::mutex> lock(pool.mutex);
+  while (pending) {
+    if (!pool.runOne(lock))
+      pool.jobsDone.wait(lock, [&]() {
+        return !pool.jobs.empty() || !pending;
+      });
+  }
+}
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <cstdint>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace utils {
+
+// fixed-size worker pool, wait() lets the calling thread help drain the queue
+class ThreadPool {
+ public:
+  ThreadPool(uint32_t numThreads = 0);
+  ~ThreadPool();
+
+  ThreadPool(const ThreadPool&) = delete;
+  ThreadPool& operator =(const ThreadPool&) = delete;
+
+  void enqueue(std::function<void()> job);
+  void wait();
+
+  uint32_t size() const {
+    return (uint32_t) workers.size();
+  }
+
+  static uint32_t hardwareThreads();
+
+ private:
+  friend class TaskGroup;
+
+  bool runOne(std::unique_lock<std::mutex> &lock);
+  void workerLoop();
+
+  std::vector<std::thread> workers;
+  std::deque<std::function<void()> > jobs;
+  std::mutex mutex;
+  std::condition_variable jobReady;
+  std::condition_variable jobsDone;
+  uint32_t running = 0;
+  bool quit = false;
+};
+
+// one pool for the whole library (hardwareThreads() workers, started on first use), callers share it
+// through TaskGroups instead of spawning and joining threads of their own per call
+ThreadPool& sharedPool();
+
+// a caller's batch of jobs on a pool: wait() only waits for these, running queued jobs meanwhile, so it is
+// safe from inside another job and doesn't block on unrelated work
+// at most limit of the batch are handed to the pool at once, 0 for no limit (the old per-call thread count)
+class TaskGroup {
+ public:
+  TaskGroup(ThreadPool &pool_ = sharedPool(), uint32_t limit_ = 0)
+      :
+      pool(pool_),
+      limit(limit_) {
+  }
+  ~TaskGroup() {
+    wait();
+  }
+
+  TaskGroup(const TaskGroup&) = delete;
+  TaskGroup& operator =(const TaskGroup&) = delete;
+
+  void enqueue(std::function<void()> job);
+  void wait();
+
+ private:
+  // with pool.mutex held
+  void submit(std::function<void()> job);
+
+  ThreadPool &pool;
+  uint32_t limit;
+  uint32_t inPool = 0, pending = 0;
+  std::deque<std::function<void()> > held;
+};
+
+}
@@ -0,0 +1,230 @@
+#include "utils/log.h"
+#include "utils/threads.h"
+
+#include "vtexture.h"
+#include "textures.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace mygl {
+
+namespace {
+
+const uint32_t maxInFlight = 64;
+
+utils::ThreadPool& workers() {
+  static utils::ThreadPool pool;
+  return pool;
+}
+
+}
+
+VirtualTexture::VirtualTexture(const char *name_, uint32_t w, uint32_t h, const char *format, uint32_t cachePages, Provider provider_)
+    :
+    name(name_),
+    pagesX(w / pageSize),
+    pagesY(h / pageSize),
+    provider(provider_) {
+  numLevels = 1;
+  while ((pagesX >> numLevels) && (pagesY >> numLevels))
+    numLevels++;
+  pages.resize(numLevels);
+  table.resize(numLevels);
+  for (uint32_t l = 0; l < numLevels; l++) {
+    pages[l].resize((size_t) (pagesX >> l) * (pagesY >> l));
+    table[l].resize(pages[l].size());
+  }
+
+  // the coarsest level is pinned, leave room for it plus a working set
+  GLint maxSize = 0;
+  glGetIntegerv( GL_MAX_TEXTURE_SIZE, &maxSize);
+  uint32_t maxSlots = std::min<uint32_t>(255, std::max<GLint>(maxSize, slotSize) / slotSize);
+  cachePages = std::max<uint32_t>(cachePages, pages[numLevels - 1].size() + 16);
+  slotsX = std::min(maxSlots, (uint32_t) ceilf(sqrtf((float) cachePages)));
+  slotsY = std::min(maxSlots, (cachePages + slotsX - 1) / slotsX);
+  slots.resize((size_t) slotsX * slotsY);
+
+  physical = std::make_shared<Texture2D>((name + "/physical").c_str(), MyGL_ROImage { .w = slotsX * slotSize, .h = slotsY * slotSize, .pixels = nullptr }, format, true, false,
+                                         false);
+
+  std::vector<texcache::Level> levels;
+  for (uint32_t l = 0; l < numLevels; l++)
+    levels.push_back(texcache::Level { .w = pagesX >> l, .h = pagesY >> l, .data = (const uint8_t*) table[l].data(), .size = table[l].size() * sizeof(MyGL_Color) });
+  MyGL_TextureOptions options = { .filtered = GL_FALSE, .mipmapped = numLevels > 1, .repeat = GL_FALSE, .mipOptions = { }, .cacheKey = 0, .progressive = GL_FALSE, .immutable = GL_FALSE, .gpuMipmaps = GL_FALSE };
+  pageTable = std::make_shared<Texture2D>((name + "/pages").c_str(), levels, "rgba8", options);
+  // the table stops at one page on the short side, so the chain ends before 1x1
+  glBindTexture( GL_TEXTURE_2D, pageTable->tex);
+  glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, numLevels - 1);
+  glBindTexture( GL_TEXTURE_2D, 0);
+}
+
+void VirtualTexture::start() {
+  uint32_t l = numLevels - 1;
+  for (uint32_t y = 0; y < (pagesY >> l); y++)
+    for (uint32_t x = 0; x < (pagesX >> l); x++)
+      request(l, x, y);
+}
+
+void VirtualTexture::request(uint32_t level, uint32_t x, uint32_t y) {
+  Page &p = page(level, x, y);
+  if (p.slot >= 0 || p.pending)
+    return;
+  p.pending = true;
+  inFlight++;
+  auto box = inbox;
+  auto fill = provider;
+  workers().enqueue([box, fill, level, x, y]() {
+    MyGL_Image tile = MyGL_imageAlloc(slotSize, slotSize);
+    fill(level, (int32_t) (x * pageSize) - (int32_t) border, (int32_t) (y * pageSize) - (int32_t) border, tile);
+    std::lock_guard<std::mutex> lock(box->mutex);
+    box->tiles.push_back(Tile { .level = level, .x = x, .y = y, .pixels = tile });
+  });
+}
+
+void VirtualTexture::feedback(const uint8_t *rgba, uint32_t count) {
+  frame++;
+
+  // one key per requested page, coarse levels sort first so fallbacks arrive before detail
+  std::vector<uint64_t> keys;
+  for (uint32_t i = 0; i < count; i++, rgba += 4) {
+    if (!rgba[3])
+      continue;
+    uint32_t level = rgba[3] - 1u;
+    uint32_t x = rgba[0] | (rgba[2] & 15u) << 8;
+    uint32_t y = rgba[1] | (rgba[2] >> 4) << 8;
+    if (level >= numLevels || x >= (pagesX >> level) || y >= (pagesY >> level))
+      continue;
+    keys.push_back((uint64_t) (numLevels - 1 - level) << 48 | (uint64_t) y << 24 | x);
+  }
+  std::sort(keys.begin(), keys.end());
+  keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+
+  for (uint64_t key : keys) {
+    uint32_t level = numLevels - 1 - (uint32_t) (key >> 48);
+    uint32_t x = (uint32_t) key & 0xffffff;
+    uint32_t y = (uint32_t) (key >> 24) & 0xffffff;
+    // the page and every ancestor it falls back to count as used
+    for (uint32_t l = level, px = x, py = y; l < numLevels; l++, px >>= 1, py >>= 1) {
+      int32_t slot = page(l, px, py).slot;
+      if (slot >= 0)
+        slots[slot].lastUsed = frame;
+    }
+    if (inFlight < maxInFlight)
+      request(level, x, y);
+  }
+}
+
+int32_t VirtualTexture::claimSlot() {
+  int32_t best = -1;
+  for (size_t i = 0; i < slots.size(); i++) {
+    const Slot &s = slots[i];
+    if (s.level < 0)
+      return (int32_t) i;
+    if (s.level == (int32_t) numLevels - 1 || s.lastUsed >= frame)
+      continue;
+    if (best < 0 || s.lastUsed < slots[best].lastUsed)
+      best = (int32_t) i;
+  }
+  return best;
+}
+
+void VirtualTexture::rebuildTable() {
+  for (int32_t l = numLevels - 1; l >= 0; l--) {
+    uint32_t w = pagesX >> l, h = pagesY >> l;
+    for (uint32_t y = 0; y < h; y++) {
+      for (uint32_t x = 0; x < w; x++) {
+        MyGL_Color &e = table[l][(size_t) y * w + x];
+        int32_t slot = page(l, x, y).slot;
+        if (slot >= 0) {
+          // uploaded as BGRA: byte 2 reads as red
+          e.rgba[2] = (uint8_t) (slot % slotsX);
+          e.rgba[1] = (uint8_t) (slot / slotsX);
+          e.rgba[0] = (uint8_t) l;
+          e.rgba[3] = 255;
+        } else if (l + 1 < (int32_t) numLevels) {
+          e = table[l + 1][(size_t) (y / 2) * (w / 2) + x / 2];
+        } else {
+          e.value = 0;
+        }
+      }
+    }
+  }
+
+  glActiveTexture( MYGL_TEXTURE_USAGE_UNIT);
+  glBindTexture( GL_TEXTURE_2D, pageTable->tex);
+  for (uint32_t l = 0; l < numLevels; l++)
+    glTexSubImage2D( GL_TEXTURE_2D, l, 0, 0, pagesX >> l, pagesY >> l, GL_BGRA, GL_UNSIGNED_BYTE, table[l].data());
+  glBindTexture( GL_TEXTURE_2D, 0);
+}
+
+uint32_t VirtualTexture::update(uint32_t maxUploads) {
+  std::vector<Tile> ready;
+  {
+    std::lock_guard<std::mutex> lock(inbox->mutex);
+    size_t n = std::min<size_t>(maxUploads ? maxUploads : inbox->tiles.size(), inbox->tiles.size());
+    ready.assign(inbox->tiles.begin(), inbox->tiles.begin() + n);
+    inbox->tiles.erase(inbox->tiles.begin(), inbox->tiles.begin() + n);
+  }
+
+  glActiveTexture( MYGL_TEXTURE_USAGE_UNIT);
+  glBindTexture( GL_TEXTURE_2D, physical->tex);
+  for (Tile &tile : ready) {
+    inFlight--;
+    Page &p = page(tile.level, tile.x, tile.y);
+    p.pending = false;
+    int32_t s = claimSlot();
+    if (s >= 0) {
+      Slot &slot = slots[s];
+      if (slot.level >= 0)
+        page(slot.level, slot.x, slot.y).slot = -1;
+      slot = Slot { .level = (int32_t) tile.level, .x = tile.x, .y = tile.y, .lastUsed = frame };
+      p.slot = s;
+      glTexSubImage2D( GL_TEXTURE_2D, 0, (s % slotsX) * slotSize, (s / slotsX) * slotSize, slotSize, slotSize, GL_BGRA, GL_UNSIGNED_BYTE, tile.pixels.pixels);
+      dirty = true;
+    }
+    // with every slot in use this frame the tile is dropped, feedback asks for it again
+    MyGL_imageFree(&tile.pixels);
+  }
+  glBindTexture( GL_TEXTURE_2D, 0);
+
+  if (dirty) {
+    rebuildTable();
+    dirty = false;
+  }
+  return inFlight;
+}
+
+const char *virtualTextureLibrary = R"(
+// virtual texture lookups, pages = '<name>/pages', physical = '<name>/physical'
+#define VT_PAGE 128.0
+#define VT_BORDER 4.0
+#define VT_SLOT 136.0
+
+float vt_level(sampler2D pages, vec2 uv, float bias) {
+  vec2 size = vec2(textureSize(pages, 0));
+  vec2 dx = dFdx(uv * size * VT_PAGE);
+  vec2 dy = dFdy(uv * size * VT_PAGE);
+  float lod = 0.5 * log2(max(dot(dx, dx), dot(dy, dy))) + bias;
+  return clamp(floor(lod), 0.0, floor(log2(min(size.x, size.y))));
+}
+
+vec4 vt_sample(sampler2D physical, sampler2D pages, vec2 uv) {
+  int level = int(vt_level(pages, uv, 0.0));
+  vec2 p = clamp(uv, 0.0, 0.99999);
+  vec4 e = floor(texelFetch(pages, ivec2(p * vec2(textureSize(pages, level))), level) * 255.0 + 0.5);
+  // e.xy = slot, e.z = level of the page (or of the ancestor standing in for it)
+  vec2 within = fract(p * vec2(textureSize(pages, int(e.z))));
+  vec2 texel = e.xy * VT_SLOT + VT_BORDER + within * VT_PAGE;
+  return textureLod(physical, texel / vec2(textureSize(physical, 0)), 0.0);
+}
+
+// output of the feedback pass, bias = -log2(downscale) when it renders at reduced size
+vec4 vt_feedback(sampler2D pages, vec2 uv, float bias) {
+  int level = int(vt_level(pages, uv, bias));
+  ivec2 page = ivec2(clamp(uv, 0.0, 0.99999) * vec2(textureSize(pages, level)));
+  return vec4(float(page.x & 255), float(page.y & 255), float((page.x >> 8) | ((page.y >> 8) << 4)), float(level + 1)) / 255.0;
+}
+)";
+
+}
@@ -0,0 +1,92 @@
+#pragma once
+
+#include "public/mygl.h"
+
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace mygl {
+
+struct Texture2D;
+
+/*
+ Sparse virtual texture: the image is cut into 128x128 pages per mip level. Resident pages live in slots of a fixed
+ physical texture ('<name>/physical'), a mip-mapped page table ('<name>/pages') maps every virtual page to the slot of
+ itself or its closest resident ancestor. Shaders sample through virtualtexture.glsl and render page requests into a
+ feedback target, which the app reads back and hands to feedback(). Tiles are produced on worker threads and uploaded
+ by update() on the GL thread.
+ */
+struct VirtualTexture {
+  static const uint32_t pageSize = 128;
+  static const uint32_t border = 4;  // filtering margin around every page
+  static const uint32_t slotSize = pageSize + 2 * border;
+
+  // fills a slotSize x slotSize tile of the given level starting at texel (x, y), may be called from any thread
+  using Provider = std::function<void(uint32_t level, int32_t x, int32_t y, MyGL_Image tile)>;
+
+  std::string name;
+  uint32_t pagesX, pagesY;
+  uint32_t numLevels;  // down to the level where the short side is one page
+  uint32_t slotsX, slotsY;
+  Provider provider;
+  std::shared_ptr<Texture2D> physical;
+  std::shared_ptr<Texture2D> pageTable;
+
+  VirtualTexture(const char *name_, uint32_t w, uint32_t h, const char *format, uint32_t cachePages, Provider provider_);
+
+  void feedback(const uint8_t *rgba, uint32_t count);
+  // uploads at most maxUploads finished tiles, returns the number of pages still being produced
+  uint32_t update(uint32_t maxUploads);
+
+  // loads the coarsest level, it is never evicted so every lookup has a fallback
+  void start();
+
+ private:
+  struct Page {
+    int32_t slot = -1;
+    bool pending = false;
+  };
+  struct Slot {
+    int32_t level = -1;
+    uint32_t x = 0, y = 0;
+    uint64_t lastUsed = 0;
+  };
+  struct Tile {
+    uint32_t level, x, y;
+    MyGL_Image pixels;
+  };
+
+  std::vector<std::vector<Page> > pages;  // per level, row major
+  std::vector<Slot> slots;
+  std::vector<std::vector<MyGL_Color> > table;
+  uint64_t frame = 1;
+  uint32_t inFlight = 0;
+  bool dirty = true;
+
+  // finished tiles, shared with the workers so a job never keeps the GL objects alive
+  struct Inbox {
+    std::mutex mutex;
+    std::vector<Tile> tiles;
+    ~Inbox() {
+      for (auto &tile : tiles)
+        MyGL_imageFree(&tile.pixels);
+    }
+  };
+  std::shared_ptr<Inbox> inbox = std::make_shared<Inbox>();
+
+  Page& page(uint32_t level, uint32_t x, uint32_t y) {
+    return pages[level][(size_t) y * (pagesX >> level) + x];
+  }
+  void request(uint32_t level, uint32_t x, uint32_t y);
+  int32_t claimSlot();
+  void rebuildTable();
+};
+
+extern const char *virtualTextureLibrary;
+extern std::map<std::string, std::shared_ptr<VirtualTexture> > namedVirtualTextures;
+
+}